@@ -0,0 +1,68 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Row-major float matrix held in a single buffer aligned to ALIGNMENT bytes.
+ * Every row starts on an ALIGNMENT byte boundary (the row stride is padded
+ * up to a multiple of ALIGNMENT bytes) and the padding is kept zeroed so that
+ * vectorised loops may safely run over the full stride of a row.
+ */
+
+#pragma once
+#ifndef RLEARNING_ALIGNED_MATRIX_H
+#define RLEARNING_ALIGNED_MATRIX_H
+
+#include <cstddef>
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+class AlignedMatrix
+{
+public:
+    static const size_t ALIGNMENT = 64; // Bytes (covers both AVX and AVX-512 loads)
+
+    AlignedMatrix();
+    AlignedMatrix( uint rows, uint cols);
+    ~AlignedMatrix();
+
+    // Set the dimensions of the matrix. The existing buffer is reused if it's
+    // large enough, otherwise it's reallocated. Contents are zeroed.
+    void create( uint rows, uint cols);
+
+    inline uint rows() const { return _rows;}
+    inline uint cols() const { return _cols;}
+    inline size_t stride() const { return _stride;}   // Floats between the start of consecutive rows
+
+    inline float* row( uint i) { return _data + i*_stride;}
+    inline const float* row( uint i) const { return _data + i*_stride;}
+
+private:
+    float *_data;
+    uint _rows, _cols;
+    size_t _stride;
+    size_t _capacity;   // Floats allocated
+
+    AlignedMatrix( const AlignedMatrix&);             // No copy
+    AlignedMatrix& operator=( const AlignedMatrix&);  // No copy
+};  // end class
+
+}   // end namespace
+
+#endif
@@ -0,0 +1,61 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Flag shared between a thread running a long computation (e.g. SVM training)
+ * and any other threads wanting to stop it early. The computation polls the
+ * token between its iterations so stopping is cooperative and takes effect at
+ * the next check rather than immediately.
+ */
+
+#pragma once
+#ifndef RLEARNING_CANCEL_TOKEN_H
+#define RLEARNING_CANCEL_TOKEN_H
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+
+
+namespace RLearning
+{
+
+class CancelToken
+{
+public:
+    typedef boost::shared_ptr<CancelToken> Ptr;
+    static Ptr create() { return Ptr( new CancelToken);}
+
+    CancelToken() : cancelled_(false) {}
+
+    // Request cancellation. May be called from any thread.
+    inline void cancel() { cancelled_.store( true, boost::memory_order_relaxed);}
+
+    // Clear a cancellation request so the token can be reused.
+    inline void reset() { cancelled_.store( false, boost::memory_order_relaxed);}
+
+    inline bool isCancelled() const { return cancelled_.load( boost::memory_order_relaxed);}
+
+private:
+    boost::atomic<bool> cancelled_;
+
+    CancelToken( const CancelToken&);             // No copy
+    CancelToken& operator=( const CancelToken&);  // No copy
+};  // end class
+
+}   // end namespace
+
+#endif
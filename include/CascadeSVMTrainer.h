@@ -0,0 +1,118 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Cascade SVM (Graf et al. 2005) for training over very large example sets.
+ * The examples are split into a power of two number of disjoint subsets that are
+ * trained as independent SVMs in parallel (one single threaded SVMTrainer per
+ * core). Only the support vectors of each are kept and merged pairwise into the
+ * subsets of the next layer, which are trained in turn (warm started from the
+ * multipliers found by the layer before) until a single subset remains. That
+ * last subset is trained with all the cores. Since examples that weren't
+ * support vectors of a subset may still be support vectors overall, the support
+ * vectors of the last layer are fed back into every subset of the first layer
+ * for another pass. Passes stop once the final support vectors stay the same
+ * from one pass to the next (or after a maximum number of passes).
+ *
+ * Richard Palmer
+ * 2017
+ */
+
+#pragma once
+#ifndef RLEARNING_CASCADE_SVM_TRAINER_H
+#define RLEARNING_CASCADE_SVM_TRAINER_H
+
+#include <vector>
+using std::vector;
+#include <opencv2/opencv.hpp>
+#include <boost/thread/mutex.hpp>
+#include "SVMParams.h"
+using RLearning::SVMParams;
+#include "SVMClassifier.h"
+using RLearning::SVMClassifier;
+#include "KernelFunc.h"
+using RLearning::KernelFunc;
+#include "WorkerPool.h"
+using RLearning::WorkerPool;
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+class CascadeSVMTrainer
+{
+public:
+    // Train with the given (non-linear) parameters splitting the examples into numParts
+    // subsets in the first layer (0 for the number of threads). numParts is rounded up
+    // to a power of two and reduced if there are too few positive or negative examples.
+    // A numThreads value of 0 uses all cores. The kernel cache budget of svmp.cacheSize()
+    // is split evenly between the subsets trained at the same time (the lesser of the
+    // number of threads and the number of subsets in the layer). A budget of 0 (the
+    // default) leaves the cache of every subset unlimited.
+    CascadeSVMTrainer( const SVMParams &svmp, uint numParts=0, uint numThreads=0, uint maxPasses=3);
+    ~CascadeSVMTrainer();
+
+    // Train over the given examples and return the classifier from the last layer of the
+    // last pass. The examples must all be continuous CV_32FC1 vectors of the same length.
+    // Returns a null pointer if there are no positive or no negative examples.
+    SVMClassifier::Ptr train( const vector<cv::Mat_<float> > &pos, const vector<cv::Mat_<float> > &neg);
+
+    // Number of passes made by the last call to train.
+    inline uint getNumPasses() const { return numPasses_;}
+
+    // True if the last call to train stopped because the support vectors of the last
+    // layer were unchanged from the pass before (rather than reaching maxPasses).
+    inline bool isConverged() const { return converged_;}
+
+private:
+    const SVMParams svmp_;
+    const KernelFunc<cv::Mat_<float> >::Ptr kernel_;
+    const uint maxPasses_;
+    uint numParts_;
+    WorkerPool *workers_;
+    uint numPasses_;
+    bool converged_;
+
+    struct Subset
+    {
+        vector<uint> pos, neg;                  // Indices of the positive and negative examples
+        vector<double> posAlphas, negAlphas;    // Initial multipliers (if warm) then those found
+        bool warm;                              // Warm start from the initial multipliers
+    };  // end struct
+
+    vector<Subset> layer_;      // Subsets of the layer being trained
+    uint nextSubset_;           // Next subset of the layer to be handed out
+    boost::mutex mutex_;        // Guards nextSubset_
+
+    const vector<cv::Mat_<float> > *pos_;   // Valid only during train()
+    const vector<cv::Mat_<float> > *neg_;   // Valid only during train()
+
+    // Train subset s with the given number of threads and kernel cache budget
+    // then reduce it to just its support vectors (and their multipliers).
+    SVMClassifier::Ptr trainSubset( Subset &s, uint nthreads, double cacheMB) const;
+
+    // Worker function training subsets of the current layer until there are none left.
+    void work( uint t);
+
+    CascadeSVMTrainer( const CascadeSVMTrainer&);             // No copy
+    CascadeSVMTrainer& operator=( const CascadeSVMTrainer&);  // No copy
+};  // end class
+
+}   // end namespace
+
+#endif
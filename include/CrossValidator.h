@@ -32,6 +32,7 @@ using boost::unordered_set;
 #include "StatsGenerator.h"  // RLearning
 #include "PCA.h"    // RLearning
 #include <Random.h> // RLIB
+typedef unsigned int uint;
 
 
 namespace RLearning
@@ -94,6 +95,14 @@ public:
     static void sampleWithReplacement( const vector<cv::Mat_<float> > &pop,
                                              vector<cv::Mat_<float> > &sampleSet, int sz, rlib::Random&);
 
+    // As above but for the multiplicities of the sample only. On return, sampleSet holds each
+    // of the pop elements drawn once and counts how many times each was drawn (the same draws
+    // from rnd are made as for sampleWithReplacement). If given, popIdxs is set with the
+    // position in pop of each element of sampleSet.
+    static void sampleWithReplacement( const vector<cv::Mat_<float> > &pop,
+                                             vector<cv::Mat_<float> > &sampleSet, vector<double> &counts,
+                                             int sz, rlib::Random&, vector<uint> *popIdxs=NULL);
+
     // Get sz samples from vector pop without replacement (ensures unique datums).
     // Returns the indices of the items taken from pop and set in vector sampleSet.
     static unordered_set<int> sampleWithoutReplacement( const vector<cv::Mat_<float> > &pop,
@@ -15,42 +15,153 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ************************************************************************/
 
+/**
+ * LIBSVM style cache of whole kernel function rows with least recently used
+ * eviction within a fixed memory budget. Row i holds K(x_i,x_k) for every
+ * training example k as type V (float by default which halves the memory per
+ * row of double so twice as many rows fit within the budget). Rows are filled by the caller (so that many
+ * threads may compute different segments of the same row in parallel)
+ * and only the leading number of entries given to setFilled are considered
+ * valid. All member functions must be called from the same (training) thread
+ * but the row memory returned from row() may be written concurrently by many
+ * threads as long as they write to different entries.
+ *
+ * An optional second tier holds rows evicted from memory in a memory mapped scratch
+ * file (with a fixed size slot per row and its own least recently used eviction).
+ * A row asked for that's in the second tier is copied back into memory rather than
+ * recalculated. Useful where kernel rows are expensive to calculate and the memory
+ * budget is too small to hold the rows in use.
+ */
+
 #pragma once
 #ifndef RLearning_KERNEL_CACHE
 #define RLearning_KERNEL_CACHE
 
-#include "SymmetricMatrix.h"
-using rlib::SymmetricMatrix;
-
-#include "SymmetricBitSet.h"
-using rlib::SymmetricBitSet;
-
 #include "KernelFunc.h"
 using RLearning::KernelFunc;
+#include "SparseMatrix.h"
+using RLearning::SparseRow;
 #include <vector>
 using std::vector;
+#include <string>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+typedef unsigned int uint;
 
 
 namespace RLearning
 {
 
-template <typename T>
+template <typename T, typename V=float>
 class KernelCache
 {
 public:
-    KernelCache( const typename KernelFunc<T>::Ptr kernel, size_t sz);
+    // Cache rows of kernel values over sz training examples using at most cacheMB
+    // megabytes (no fewer than two rows are kept). If cacheMB is zero (the default)
+    // there is no limit and every row can be held at once.
+    KernelCache( const typename KernelFunc<T>::Ptr kernel, size_t sz, double cacheMB=0);
     ~KernelCache();
 
+    // Return K(xi,xj) from the cached row of i or j if available, otherwise
+    // calculate it directly (single values are not cached).
     double krn( uint i, const T &xi, uint j, const T &xj);
 
+    // As above but for examples given as raw (contiguous) float vectors of length n.
+    double krn( uint i, const float *xi, uint j, const float *xj, int n);
+
+    // As above but for sparse rows with squared norms sqi and sqj.
+    double krn( uint i, const SparseRow &xi, double sqi, uint j, const SparseRow &xj, double sqj);
+
+    // Set v to K(x_i,x_j) and return true iff available from the cached row of i or j.
+    // Doesn't change the cache so may be called concurrently by many threads (as long
+    // as no other member functions are called at the same time).
+    bool cached( uint i, uint j, double &v) const;
+
+    // Return row i making it the most recently used row (this may evict the least
+    // recently used row). On return, filled is set to the number of leading entries
+    // of the row already calculated. Entries from filled on should be calculated by
+    // the caller with setFilled called once done. Since at least two rows are held,
+    // the row returned by the previous call to this function is never evicted.
+    V* row( uint i, uint &filled);
+
+    // Set the leading number of entries of (resident) row i that are calculated. The new
+    // entries are counted as evaluations only if computed (i.e. not copied from elsewhere).
+    void setFilled( uint i, uint len, bool computed=true);
+
+    // Swap the positions of examples i and j in the cache (both the rows and the row entries).
+    // Rows that aren't filled past both positions are truncated to the smaller position
+    // (as are all spilled rows so the second tier isn't read to swap their entries).
+    void swapIndex( uint i, uint j);
+
+    // Add a second tier of diskMB megabytes behind the memory budget. Rows evicted from
+    // memory are spilled to a scratch file created in directory dir and mapped into memory.
+    // The file is unlinked once mapped so it's removed when this cache is destroyed (or the
+    // process exits). Returns false (leaving no second tier) if the file can't be created
+    // and mapped or if diskMB is too small for a single row. Call before any other use.
+    bool enableDiskTier( const std::string &dir, double diskMB);
+
+    // Maximum number of rows held at once.
+    inline uint maxRows() const { return maxRows_;}
+
+    // Maximum number of rows held in the second tier (0 if there is none).
+    inline uint maxDiskRows() const { return maxDiskRows_;}
+
+    // Number of row() misses from memory that were copied back from the second tier.
+    inline size_t diskHits() const { return diskHits_;}
+
+    // Lookup statistics for row() and krn() calls.
+    inline size_t hits() const { return hits_;}
+    inline size_t misses() const { return misses_;}
+    double hitRate() const;
+
+    // Number of kernel values calculated (krn() misses plus row entries marked filled by setFilled).
+    inline size_t evaluations() const { return evals_;}
+
     // Return the kernel function object used for this cache.
     inline typename KernelFunc<T>::Ptr getKernel() const { return kernel;}
 
 private:
     // The kernel function (linear, polynomial, gaussian etc)
     const typename KernelFunc<T>::Ptr kernel;
-    SymmetricMatrix<double> *vals;  // Cached kernel function values
-    SymmetricBitSet *flags;        // Whether kernel function values have been cached or not
+    const uint sz_;         // Number of examples (length of each row)
+    uint maxRows_;          // Most rows allowed at once
+    uint numRows_;          // Rows currently allocated
+    vector<V*> rows_;       // Cached rows (NULL if not resident)
+    vector<uint> filled_;   // Leading entries calculated for each resident row
+    vector<int> prev_;      // LRU doubly linked list over resident rows
+    vector<int> next_;      // (element sz_ is the head; next_ is towards least recently used)
+    size_t hits_, misses_;
+    size_t evals_;
+
+    uint maxDiskRows_;          // Row slots in the second tier (0 if none)
+    char *disk_;                // Mapped scratch file (NULL if no second tier)
+    size_t diskBytes_;          // Length of the mapping
+    vector<int> slot_;          // Slot in the second tier of each spilled row (-1 if not spilled)
+    vector<uint> diskFilled_;   // Leading entries calculated for each spilled row
+    vector<int> freeSlots_;
+    vector<int> dprev_;         // LRU doubly linked list over spilled rows
+    vector<int> dnext_;         // (element sz_ is the head as for prev_ and next_)
+    size_t diskHits_;
+
+    void unlink( uint i);
+    void pushFront( uint i);
+    void unlinkDisk( uint i);
+    void pushFrontDisk( uint i);
+
+    // Copy the filled leading entries of row i (being evicted from memory) to the second tier.
+    void spill( uint i, const V *r, uint filled);
+
+    inline V* slotRow( int s) const { return reinterpret_cast<V*>( disk_ + size_t(s) * sz_ * sizeof(V));}
+
+    KernelCache( const KernelCache&);             // No copy
+    KernelCache& operator=( const KernelCache&);  // No copy
 };  // end class KernelCache
 
 #include "template/KernelCache_template.h"
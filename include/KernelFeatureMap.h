@@ -0,0 +1,149 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Explicit feature maps z(x) approximating a kernel as K(x,y) ~ z(x).z(y) so that
+ * a non-linear SVM can be trained by LinearSVMTrainer over the mapped examples and
+ * evaluated as a single dot product with its weight vector (linx). The cost of a
+ * prediction is then that of mapping the example (O(D.d) for D output dimensions)
+ * regardless of how many support vectors an exactly trained SVM would have had.
+ *
+ * RandomFourierMap (Rahimi & Recht 2007) approximates the Gaussian kernel using D
+ * random projections. NystroemMap (Williams & Seeger 2001) approximates any kernel
+ * from its values against a subset of landmark examples. measureApproximation
+ * reports how closely the mapped inner products match the exact kernel.
+ *
+ * Richard Palmer
+ * 2017
+ */
+
+#pragma once
+#ifndef RLEARNING_KERNEL_FEATURE_MAP_H
+#define RLEARNING_KERNEL_FEATURE_MAP_H
+
+#include <vector>
+using std::vector;
+#include <opencv2/opencv.hpp>
+#include <boost/shared_ptr.hpp>
+#include "KernelFunc.h"
+using RLearning::KernelFunc;
+#include "SVMParams.h"
+using RLearning::SVMParams;
+#include "SVMClassifier.h"
+using RLearning::SVMClassifier;
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+// Agreement between mapped inner products and the exact kernel over sampled pairs of examples.
+struct KernelApproxStats
+{
+    uint numPairs;
+    double meanAbsError;
+    double maxAbsError;
+    double rmsError;
+};  // end struct
+
+
+class KernelFeatureMap
+{
+public:
+    typedef boost::shared_ptr<KernelFeatureMap> Ptr;
+
+    // Create a map of (about) D dimensions for the kernel of svmp. A RandomFourierMap
+    // is created for the RBF kernel and a NystroemMap with D landmarks drawn at random
+    // from xs for any other. Returns a null pointer if svmp's kernel is linear.
+    static Ptr create( const SVMParams &svmp, const vector<cv::Mat_<float> > &xs, int D, uint seed=0);
+
+    virtual ~KernelFeatureMap(){}
+
+    virtual int inputDims() const = 0;
+    virtual int outputDims() const = 0;
+
+    // Map raw input vector x (of length inputDims) to z (of length outputDims).
+    virtual void map( const float *x, float *z) const = 0;
+
+    // Map x (continuous CV_32FC1 of inputDims elements) returning a 1 x outputDims row vector.
+    cv::Mat_<float> map( const cv::Mat_<float> &x) const;
+
+    // Map each of the given examples.
+    vector<cv::Mat_<float> > map( const vector<cv::Mat_<float> > &xs) const;
+
+    // Map the examples and train a linear SVM over them with svmp's cost and convergence tolerance.
+    // The classifier returned is linear over the mapped examples so should be used with predict below.
+    SVMClassifier::Ptr train( const vector<cv::Mat_<float> > &pos, const vector<cv::Mat_<float> > &neg,
+                              const SVMParams &svmp, uint maxIterations=1000) const;
+
+    // Map x and return the prediction of linear classifier svmc (as returned from train).
+    float predict( const SVMClassifier &svmc, const cv::Mat_<float> &x) const;
+
+    // Compare z(x).z(y) against the exact kernel K(x,y) over up to numPairs random pairs of xs.
+    KernelApproxStats measureApproximation( const KernelFunc<cv::Mat_<float> > &kernel,
+                                            const vector<cv::Mat_<float> > &xs,
+                                            uint numPairs=1000, uint seed=0) const;
+};  // end class
+
+
+// Map for the Gaussian kernel exp(-gam*||x-y||^2) as z(x) = sqrt(2/D)cos(Wx + b)
+// with the D rows of W drawn from N(0,2gam I) and b uniform over [0,2pi).
+class RandomFourierMap : public KernelFeatureMap
+{
+public:
+    RandomFourierMap( int dims, double gam, int D, uint seed=0);
+
+    virtual int inputDims() const { return W_.cols;}
+    virtual int outputDims() const { return W_.rows;}
+    virtual void map( const float *x, float *z) const;
+    using KernelFeatureMap::map;
+
+private:
+    cv::Mat_<float> W_;
+    vector<const float*> wps_;  // Rows of W_
+    vector<float> b_;
+    float scale_;
+};  // end class
+
+
+// Map for any kernel from its values against m landmark examples as z(x) = P k(x)
+// where k(x)_i = K(x,l_i) and P = L^(-1/2) U' from the eigen decomposition U L U' of
+// the landmarks' kernel matrix. Eigenvalues smaller than relTol times the largest are
+// dropped so outputDims may be less than the number of landmarks.
+class NystroemMap : public KernelFeatureMap
+{
+public:
+    NystroemMap( const KernelFunc<cv::Mat_<float> >::Ptr kernel,
+                 const vector<cv::Mat_<float> > &landmarks, double relTol=1e-8);
+
+    virtual int inputDims() const { return L_.cols;}
+    virtual int outputDims() const { return P_.rows;}
+    virtual void map( const float *x, float *z) const;
+    using KernelFeatureMap::map;
+
+private:
+    const KernelFunc<cv::Mat_<float> >::Ptr kernel_;
+    cv::Mat_<float> L_;         // Landmarks (one per row)
+    vector<const float*> lps_;  // Rows of L_
+    vector<double> lsqs_;       // Squared norms of the landmarks
+    cv::Mat_<float> P_;         // Projection from landmark kernel values
+    vector<const float*> pps_;  // Rows of P_
+};  // end class
+
+}   // end namespace
+
+#endif
@@ -28,16 +28,20 @@
 #define RLEARNING_KERNEL_FUNC
 
 #include <cmath>
+#include <algorithm>
 #include <string>
 using std::string;
+#include <iostream>
+#include <cassert>
 #include <boost/shared_ptr.hpp>
 #include <opencv2/opencv.hpp>
+#include "VectorOps.h"
+#include "SparseMatrix.h"
 
 
 namespace RLearning
 {
 
-
 template<typename T>
 class KernelFunc
 {
@@ -46,6 +50,143 @@ public:
 
     virtual double operator()( const T &x1, const T &x2) const = 0;  // The kernel function
     virtual string getType() const = 0; // Return string identifier of kernel type
+
+    // The kernel function over two raw (contiguous) float vectors of length n.
+    // The default wraps the data in matrix headers and calls the above but
+    // all the kernels below override this to work on the pointers directly.
+    virtual double operator()( const float *x1, const float *x2, int n) const
+    {
+        const cv::Mat_<float> m1( 1, n, const_cast<float*>(x1));
+        const cv::Mat_<float> m2( 1, n, const_cast<float*>(x2));
+        return (*this)( T(m1), T(m2));
+    }   // end operator()
+
+    // Set ki[k] = K(xi,xks[k]) and kj[k] = K(xj,xks[k]) for k in [0,nks) where all
+    // vectors are of length n. Used to fill two kernel matrix rows at a time and
+    // overridden by the kernels below to read each xks[k] only once for both rows.
+    // Callers should prefer these batch functions in inner loops since the kernel type
+    // (and the instruction set in the overrides) is then dispatched once per batch.
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       float *ki, float *kj) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+        {
+            ki[k] = float( (*this)( xi, xks[k], n));
+            kj[k] = float( (*this)( xj, xks[k], n));
+        }   // end for
+    }   // end rows
+
+    // Set ki[k] = K(xi,xks[k]) for k in [0,nks).
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, float *ki) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+            ki[k] = float( (*this)( xi, xks[k], n));
+    }   // end row
+
+    // As rows() and row() but also given the squared norms of xi (sqi), xj (sqj) and
+    // each xks[k] (sqks[k]) as cached by the caller. Kernels of the distance between
+    // examples override these to find it from a dot product. The defaults ignore the norms.
+    virtual void normRows( const float *xi, double sqi, const float *xj, double sqj,
+                           const float *const *xks, const double *sqks, uint nks, int n,
+                           float *ki, float *kj) const
+    {
+        rows( xi, xj, xks, nks, n, ki, kj);
+    }   // end normRows
+
+    virtual void normRow( const float *xi, double sqi, const float *const *xks, const double *sqks,
+                          uint nks, int n, float *ki) const
+    {
+        row( xi, xks, nks, n, ki);
+    }   // end normRow
+
+    // Double precision versions of the batch functions for callers keeping kernel values
+    // as double. The kernels below override these to find the inner products (or distances)
+    // a batch at a time in double and apply the kernel in double. The defaults evaluate
+    // the kernel exactly one entry at a time (ignoring the norms).
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       double *ki, double *kj) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+        {
+            ki[k] = (*this)( xi, xks[k], n);
+            kj[k] = (*this)( xj, xks[k], n);
+        }   // end for
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, double *ki) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+            ki[k] = (*this)( xi, xks[k], n);
+    }   // end row
+
+    virtual void normRows( const float *xi, double sqi, const float *xj, double sqj,
+                           const float *const *xks, const double *sqks, uint nks, int n,
+                           double *ki, double *kj) const
+    {
+        rows( xi, xj, xks, nks, n, ki, kj);
+    }   // end normRows
+
+    virtual void normRow( const float *xi, double sqi, const float *const *xks, const double *sqks,
+                          uint nks, int n, double *ki) const
+    {
+        row( xi, xks, nks, n, ki);
+    }   // end normRow
+
+    // Set ki[k] = K(xi,xks[k]) for k in [0,nks) where xi and the xks[k] are sparse rows
+    // with squared norms sqi and sqks[k]. The inner products are found over the non-zeros
+    // only and are turned into kernel values by fromDots a batch at a time.
+    template <typename W>
+    void sparseRow( const SparseRow &xi, double sqi, const SparseRow *xks, const double *sqks,
+                    uint nks, W *ki) const
+    {
+        double d[SPARSEBATCH];
+        for ( uint k0 = 0; k0 < nks; k0 += SPARSEBATCH)
+        {
+            const uint m = std::min<uint>( SPARSEBATCH, nks - k0);
+            for ( uint k = 0; k < m; ++k)
+                d[k] = sparseDot( xi, xks[k0+k]);
+            fromDots( sqi, &sqks[k0], m, d);
+            for ( uint k = 0; k < m; ++k)
+                ki[k0+k] = W(d[k]);
+        }   // end for
+    }   // end sparseRow
+
+    // As above but against dense vectors xks[k] (e.g. the support vectors of a classifier)
+    // which are only read at the non-zeros of xi.
+    template <typename W>
+    void sparseRow( const SparseRow &xi, double sqi, const float *const *xks, const double *sqks,
+                    uint nks, W *ki) const
+    {
+        double d[SPARSEBATCH];
+        for ( uint k0 = 0; k0 < nks; k0 += SPARSEBATCH)
+        {
+            const uint m = std::min<uint>( SPARSEBATCH, nks - k0);
+            for ( uint k = 0; k < m; ++k)
+                d[k] = sparseDot( xi, xks[k0+k]);
+            fromDots( sqi, &sqks[k0], m, d);
+            for ( uint k = 0; k < m; ++k)
+                ki[k0+k] = W(d[k]);
+        }   // end for
+    }   // end sparseRow
+
+    // Turn in place the inner products d[k] of some x (with squared norm sqi) with nks
+    // other vectors (with squared norms sqks[k]) into the kernel values. Needed for the
+    // sparse functions above which kernels not overriding this don't support.
+    virtual void fromDots( double sqi, const double *sqks, uint nks, double *d) const
+    {
+        std::cerr << "Kernel " << getType() << " doesn't support sparse vectors!" << std::endl;
+        assert(false);
+    }   // end fromDots
+
+protected:
+    enum { SPARSEBATCH = 256};  // Inner products found per call to fromDots
+    enum { DOTBATCH = 256};     // Inner products held in double per batch by the dense batch functions
+
+    // True iff both matrices can be read as raw vectors (avoiding temporaries).
+    static bool isRaw( const T &x1, const T &x2)
+    {
+        return x1.isContinuous() && x2.isContinuous() && x1.total() == x2.total();
+    }   // end isRaw
 };  // end class KernelFunc
 
 
@@ -56,9 +197,40 @@ class LinearKernel : public KernelFunc<T>
 public:
     virtual double operator()( const T &x1, const T &x2) const
     {
+        if ( KernelFunc<T>::isRaw( x1, x2))
+            return (*this)( x1.template ptr<float>(0), x2.template ptr<float>(0), (int)x1.total());
         return x1.dot(x2);
     }   // end operator()
 
+    virtual double operator()( const float *x1, const float *x2, int n) const
+    {
+        return dotProduct( x1, x2, n);
+    }   // end operator()
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       float *ki, float *kj) const
+    {
+        dotProductRows( xi, xj, xks, nks, n, ki, kj);
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, float *ki) const
+    {
+        dotProductRows( xi, NULL, xks, nks, n, ki, NULL);
+    }   // end row
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       double *ki, double *kj) const
+    {
+        dotProductRows( xi, xj, xks, nks, n, ki, kj);
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, double *ki) const
+    {
+        dotProductRows( xi, NULL, xks, nks, n, ki, NULL);
+    }   // end row
+
+    virtual void fromDots( double, const double*, uint, double*) const {}   // The inner products are the kernel
+
     static string Type;
     virtual string getType() const { return LinearKernel::Type;}
 };  // end class LinearKernel
@@ -75,9 +247,54 @@ public:
 
     virtual double operator()( const T &x1, const T &x2) const
     {
+        if ( KernelFunc<T>::isRaw( x1, x2))
+            return (*this)( x1.template ptr<float>(0), x2.template ptr<float>(0), (int)x1.total());
         return pow(gam * x1.dot(x2) + cf0, degree);
     }   // end operator()
 
+    virtual double operator()( const float *x1, const float *x2, int n) const
+    {
+        return pow(gam * dotProduct( x1, x2, n) + cf0, degree);
+    }   // end operator()
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       float *ki, float *kj) const
+    {
+        dotProductRows( xi, xj, xks, nks, n, ki, kj);
+        for ( uint k = 0; k < nks; ++k)
+        {
+            ki[k] = float( pow(gam * ki[k] + cf0, degree));
+            kj[k] = float( pow(gam * kj[k] + cf0, degree));
+        }   // end for
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, float *ki) const
+    {
+        dotProductRows( xi, NULL, xks, nks, n, ki, NULL);
+        for ( uint k = 0; k < nks; ++k)
+            ki[k] = float( pow(gam * ki[k] + cf0, degree));
+    }   // end row
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       double *ki, double *kj) const
+    {
+        dotProductRows( xi, xj, xks, nks, n, ki, kj);
+        fromDots( 0, NULL, nks, ki);
+        fromDots( 0, NULL, nks, kj);
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, double *ki) const
+    {
+        dotProductRows( xi, NULL, xks, nks, n, ki, NULL);
+        fromDots( 0, NULL, nks, ki);
+    }   // end row
+
+    virtual void fromDots( double, const double*, uint nks, double *d) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+            d[k] = pow(gam * d[k] + cf0, degree);
+    }   // end fromDots
+
     static string Type;
     virtual string getType() const { return PolyKernel::Type;}
 
@@ -105,10 +322,85 @@ public:
     GaussianKernel( double g) : gam(g) {}
     virtual double operator()( const T &x1, const T &x2) const
     {
+        if ( KernelFunc<T>::isRaw( x1, x2))
+            return (*this)( x1.template ptr<float>(0), x2.template ptr<float>(0), (int)x1.total());
         T d = x1 - x2;  // We assume that T implements dot() here!
         return exp( -gam*d.dot(d));
     }   // end operator()
 
+    virtual double operator()( const float *x1, const float *x2, int n) const
+    {
+        return exp( -gam*sqDistance( x1, x2, n));
+    }   // end operator()
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       float *ki, float *kj) const
+    {
+        sqDistanceRows( xi, xj, xks, nks, n, ki, kj);
+        for ( uint k = 0; k < nks; ++k)
+        {
+            ki[k] = float( exp( -gam*ki[k]));
+            kj[k] = float( exp( -gam*kj[k]));
+        }   // end for
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, float *ki) const
+    {
+        sqDistanceRows( xi, NULL, xks, nks, n, ki, NULL);
+        for ( uint k = 0; k < nks; ++k)
+            ki[k] = float( exp( -gam*ki[k]));
+    }   // end row
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       double *ki, double *kj) const
+    {
+        sqDistanceRows( xi, xj, xks, nks, n, ki, kj);
+        for ( uint k = 0; k < nks; ++k)
+        {
+            ki[k] = exp( -gam*ki[k]);
+            kj[k] = exp( -gam*kj[k]);
+        }   // end for
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, double *ki) const
+    {
+        sqDistanceRows( xi, NULL, xks, nks, n, ki, NULL);
+        for ( uint k = 0; k < nks; ++k)
+            ki[k] = exp( -gam*ki[k]);
+    }   // end row
+
+    virtual void normRows( const float *xi, double sqi, const float *xj, double sqj,
+                           const float *const *xks, const double *sqks, uint nks, int n,
+                           float *ki, float *kj) const
+    {
+        normRowsFromDots( xi, sqi, xj, sqj, xks, sqks, nks, n, ki, kj);
+    }   // end normRows
+
+    virtual void normRow( const float *xi, double sqi, const float *const *xks, const double *sqks,
+                          uint nks, int n, float *ki) const
+    {
+        normRowsFromDots( xi, sqi, NULL, 0, xks, sqks, nks, n, ki, (float*)NULL);
+    }   // end normRow
+
+    virtual void normRows( const float *xi, double sqi, const float *xj, double sqj,
+                           const float *const *xks, const double *sqks, uint nks, int n,
+                           double *ki, double *kj) const
+    {
+        normRowsFromDots( xi, sqi, xj, sqj, xks, sqks, nks, n, ki, kj);
+    }   // end normRows
+
+    virtual void normRow( const float *xi, double sqi, const float *const *xks, const double *sqks,
+                          uint nks, int n, double *ki) const
+    {
+        normRowsFromDots( xi, sqi, NULL, 0, xks, sqks, nks, n, ki, (double*)NULL);
+    }   // end normRow
+
+    virtual void fromDots( double sqi, const double *sqks, uint nks, double *d) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+            d[k] = exp( -gam*std::max( 0.0, sqi + sqks[k] - 2*d[k]));
+    }   // end fromDots
+
     static string Type;
     virtual string getType() const { return GaussianKernel::Type;}
 
@@ -117,6 +409,27 @@ public:
 
 private:
     double gam;
+
+    // ||xi - xk||^2 = ||xi||^2 + ||xk||^2 - 2xi.xk (clamped at zero against rounding). The inner
+    // products are kept in double since the subtraction cancels most of their leading digits
+    // when the norms are large compared with the distance. kj is only set if xj isn't NULL.
+    template <typename W>
+    void normRowsFromDots( const float *xi, double sqi, const float *xj, double sqj,
+                           const float *const *xks, const double *sqks, uint nks, int n, W *ki, W *kj) const
+    {
+        double di[KernelFunc<T>::DOTBATCH], dj[KernelFunc<T>::DOTBATCH];
+        for ( uint k0 = 0; k0 < nks; k0 += KernelFunc<T>::DOTBATCH)
+        {
+            const uint m = std::min<uint>( KernelFunc<T>::DOTBATCH, nks - k0);
+            dotProductRows( xi, xj, &xks[k0], m, n, di, xj ? dj : NULL);
+            for ( uint k = 0; k < m; ++k)
+                ki[k0+k] = W( exp( -gam*std::max( 0.0, sqi + sqks[k0+k] - 2*di[k])));
+            if ( xj == NULL)
+                continue;
+            for ( uint k = 0; k < m; ++k)
+                kj[k0+k] = W( exp( -gam*std::max( 0.0, sqj + sqks[k0+k] - 2*dj[k])));
+        }   // end for
+    }   // end normRowsFromDots
 };  // end class GaussianKernel
 template<typename T> string GaussianKernel<T>::Type = "rbf";
 
@@ -130,9 +443,54 @@ public:
     SigmoidKernel( double g, double c) : gam(g), cf0(c) {}
     virtual double operator()( const T &x1, const T &x2) const
     {
+        if ( KernelFunc<T>::isRaw( x1, x2))
+            return (*this)( x1.template ptr<float>(0), x2.template ptr<float>(0), (int)x1.total());
         return tanh( gam*x1.dot(x2) + cf0);
     }   // end operator()
 
+    virtual double operator()( const float *x1, const float *x2, int n) const
+    {
+        return tanh( gam*dotProduct( x1, x2, n) + cf0);
+    }   // end operator()
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       float *ki, float *kj) const
+    {
+        dotProductRows( xi, xj, xks, nks, n, ki, kj);
+        for ( uint k = 0; k < nks; ++k)
+        {
+            ki[k] = float( tanh( gam*ki[k] + cf0));
+            kj[k] = float( tanh( gam*kj[k] + cf0));
+        }   // end for
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, float *ki) const
+    {
+        dotProductRows( xi, NULL, xks, nks, n, ki, NULL);
+        for ( uint k = 0; k < nks; ++k)
+            ki[k] = float( tanh( gam*ki[k] + cf0));
+    }   // end row
+
+    virtual void rows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                       double *ki, double *kj) const
+    {
+        dotProductRows( xi, xj, xks, nks, n, ki, kj);
+        fromDots( 0, NULL, nks, ki);
+        fromDots( 0, NULL, nks, kj);
+    }   // end rows
+
+    virtual void row( const float *xi, const float *const *xks, uint nks, int n, double *ki) const
+    {
+        dotProductRows( xi, NULL, xks, nks, n, ki, NULL);
+        fromDots( 0, NULL, nks, ki);
+    }   // end row
+
+    virtual void fromDots( double, const double*, uint nks, double *d) const
+    {
+        for ( uint k = 0; k < nks; ++k)
+            d[k] = tanh( gam*d[k] + cf0);
+    }   // end fromDots
+
     static string Type;
     virtual string getType() const { return SigmoidKernel::Type;}
 
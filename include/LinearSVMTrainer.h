@@ -0,0 +1,104 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Trainer for linear SVMs using dual coordinate descent as in LIBLINEAR
+ * ("A Dual Coordinate Descent Method for Large-scale Linear SVM", Hsieh et al., 2008).
+ * The weight vector is maintained explicitly so each multiplier update costs O(d)
+ * and no kernel values are calculated or stored. The threshold is learned as the
+ * weight on an extra constant feature so (unlike with SVMTrainer) it's regularised
+ * along with the other weights. The classifiers produced are the same linear
+ * SVMClassifier representation as produced by SVMTrainer with a linear kernel.
+ */
+
+#pragma once
+#ifndef RLearning_LINEAR_SVM_TRAINER
+#define RLearning_LINEAR_SVM_TRAINER
+
+#include <vector>
+using std::vector;
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <sys/time.h>
+#include <boost/unordered_map.hpp>
+#include <Random.h> // RLIB
+
+#include "SVMParams.h"
+using RLearning::SVMParams;
+#include "SVMClassifier.h"
+using RLearning::SVMClassifier;
+#include "AlignedMatrix.h"
+using RLearning::AlignedMatrix;
+#include "VectorOps.h"
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+template <typename T>
+class LinearSVMTrainer
+{
+public:
+    // Train with the cost and convergence tolerance given in svmp (the kernel must be linear).
+    // The convergence tolerance bounds the largest violation of the optimality conditions.
+    // Training stops after maxIterations passes over the examples if not converged.
+    explicit LinearSVMTrainer( const SVMParams &svmp, uint maxIterations=1000);
+    LinearSVMTrainer( double cost=1e-1, double convTolerance=1e-3, uint maxIterations=1000);
+
+    // Optimise the weights and return the classifier.
+    SVMClassifier::Ptr train( const vector<T> &pos, const vector<T> &neg);
+
+    // Warm started training from the multipliers found by the last call to train()
+    // or retrain() on this object. Examples are matched to those last trained on by
+    // identity (their data pointers) so examples held over from the last training set
+    // resume from their old multipliers and new examples start from zero.
+    SVMClassifier::Ptr retrain( const vector<T> &pos, const vector<T> &neg);
+
+    // Enable or disable error output on the training passes to show convergence.
+    void enableErrorOutput( bool enable);
+
+    // Return the number of passes over the examples made by the last training run.
+    inline uint getNumIterations() const { return numIts_;}
+
+private:
+    const double COST;          // Cost weighting on misclassified training data
+    const double EPS;           // Convergence tolerance
+    const uint MAXITS;          // Most passes over the training examples
+    bool enableErrOut_;         // If true, error output (convergence info) displayed
+    uint numIts_;               // Passes made in the last training run
+
+    AlignedMatrix xmat;         // Packed training instances (positive instances first)
+    vector<double> alphas;      // Lagrange multipliers for each training example
+    vector<double> w;           // Weights (with the bias weight last)
+    boost::unordered_map<const void*, double> seeds_;   // Non-zero multipliers from the last run keyed by example data
+
+    // Train from initAlphas (ordered as pos then neg) or from zero if NULL.
+    SVMClassifier::Ptr trainFrom( const vector<T> &pos, const vector<T> &neg, const vector<double> *initAlphas);
+
+    static const double BIAS;   // Value of the constant feature appended to every example
+};  // end class LinearSVMTrainer
+
+#include "template/LinearSVMTrainer_template.h"
+
+}   // end namespace
+
+#endif
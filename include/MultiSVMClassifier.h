@@ -0,0 +1,127 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Multi-class SVM classifier made up of binary SVM decision functions (one per
+ * class for one-vs-rest or one per pair of classes for one-vs-one) over a single
+ * pool of support vectors. A training example that's a support vector of more
+ * than one binary problem is held once, so predicting an example finds its
+ * kernel value against each support vector once and every binary decision
+ * function is then a weighted sum over those values. Usually created by a
+ * MultiSVMTrainer.
+ *
+ * Richard Palmer
+ * 2017
+ */
+
+#pragma once
+#ifndef RLEARNING_MULTI_SVM_CLASSIFIER_H
+#define RLEARNING_MULTI_SVM_CLASSIFIER_H
+
+#include <vector>
+using std::vector;
+#include <opencv2/opencv.hpp>
+#include <boost/shared_ptr.hpp>
+#include "SVMParams.h"
+using RLearning::SVMParams;
+#include "KernelFunc.h"
+using RLearning::KernelFunc;
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+class MultiSVMClassifier
+{
+public:
+    typedef boost::shared_ptr<MultiSVMClassifier> Ptr;
+
+    enum Scheme
+    {
+        OneVsRest,  // One problem per class of that class against all the others
+        OneVsOne    // One problem per pair of classes with the class chosen by vote
+    };  // end enum
+
+    // Create a classifier over the given (distinct and ascending) class labels and
+    // the pool of support vectors (which are copied). Add the binary decision functions
+    // with addProblem.
+    MultiSVMClassifier( const SVMParams &svmp, Scheme scheme, const vector<int> &classes,
+                        const vector<cv::Mat_<float> > &svs);
+
+    // Add the next binary decision function (posClass against negClass or against all the
+    // other classes if negClass is -1) with classes given by their index into the classes
+    // given on construction. The decision function is the sum of coefs[k] * K(svs[svIdxs[k]],z)
+    // less threshold b where coefs are the multipliers times the (1 or -1) targets.
+    // Set converged to false if the binary problem stopped before convergence.
+    void addProblem( int posClass, int negClass, const vector<uint> &svIdxs,
+                     const vector<double> &coefs, double b, bool converged=true);
+
+    // Return the label of the class z is predicted to be.
+    int predict( const cv::Mat_<float> &z) const;
+
+    // Predict the class of every row of zs into labels.
+    void predict( const cv::Mat_<float> &zs, vector<int> &labels) const;
+
+    // Set dvs to the value of each binary decision function for z (>= 0 for the positive class
+    // of the problem). Values are normalised by the length of z as with SVMClassifier::predict.
+    void decisionValues( const cv::Mat_<float> &z, vector<float> &dvs) const;
+
+    inline Scheme getScheme() const { return scheme_;}
+    inline const vector<int>& getClasses() const { return classes_;}
+    inline uint getNumSVs() const { return uint(svs_.size());}
+    inline uint getNumProblems() const { return uint(problems_.size());}
+    inline const SVMParams& getParams() const { return svmp_;}
+
+    // Set posClass and negClass to the class indices of binary problem p (negClass is -1 for one-vs-rest).
+    void getProblemClasses( uint p, int &posClass, int &negClass) const;
+
+    // False if any of the binary problems stopped before convergence.
+    inline bool isConverged() const { return converged_;}
+
+private:
+    struct Problem
+    {
+        int posClass, negClass; // Class indices of the problem (negClass -1 for one-vs-rest)
+        vector<uint> svIdxs;    // Support vectors of this problem (indices into svs_)
+        vector<double> coefs;   // Multipliers times targets
+        double b;               // Threshold
+    };  // end struct
+
+    const SVMParams svmp_;
+    const Scheme scheme_;
+    const vector<int> classes_;
+    vector<cv::Mat_<float> > svs_;  // Pool of support vectors (all continuous)
+    vector<const float*> svps_;     // Raw data of the support vectors
+    vector<double> svsqs_;          // Squared norms of the support vectors
+    vector<Problem> problems_;
+    KernelFunc<cv::Mat_<float> >::Ptr kernel_;
+    bool converged_;
+
+    // Set kz to the kernel value of z against every support vector.
+    void kernelRow( const float *z, int n, vector<float> &kz) const;
+
+    // Set dvs to the decision values given the kernel row of an example of length n.
+    void decisionValues( const vector<float> &kz, int n, vector<float> &dvs) const;
+
+    // Return the predicted class label from the decision values.
+    int decide( const vector<float> &dvs) const;
+};  // end class
+
+}   // end namespace
+
+#endif
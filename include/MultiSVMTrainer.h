@@ -0,0 +1,99 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Trains a multi-class SVM as a set of binary SVMs (one-vs-rest or one-vs-one)
+ * over one pool of examples. The binary problems are handed out to worker threads
+ * as they become free, each solved by a single threaded SVMTrainer. All of them
+ * gather their kernel rows from one SharedKernelCache over the pool so a kernel
+ * value needed by many problems is calculated once rather than once per problem.
+ *
+ * Richard Palmer
+ * 2017
+ */
+
+#pragma once
+#ifndef RLEARNING_MULTI_SVM_TRAINER_H
+#define RLEARNING_MULTI_SVM_TRAINER_H
+
+#include <vector>
+using std::vector;
+#include <opencv2/opencv.hpp>
+#include <boost/thread/mutex.hpp>
+#include "SVMParams.h"
+using RLearning::SVMParams;
+#include "MultiSVMClassifier.h"
+using RLearning::MultiSVMClassifier;
+#include "SharedKernelCache.h"
+using RLearning::SharedKernelCache;
+#include "WorkerPool.h"
+using RLearning::WorkerPool;
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+class MultiSVMTrainer
+{
+public:
+    // Train with the given parameters (a kernel row cache of svmp.cacheSize() MB is
+    // shared by all the binary problems). A numThreads value of 0 uses all cores.
+    MultiSVMTrainer( const SVMParams &svmp,
+                     MultiSVMClassifier::Scheme scheme=MultiSVMClassifier::OneVsRest, uint numThreads=0);
+    ~MultiSVMTrainer();
+
+    // Train over the examples in the rows of xs (CV_32FC1) with the class labels in the
+    // columns of labels (CV_32SC1) as for CrossValidator. There must be at least two classes.
+    // Returns a null pointer if there are fewer than two classes.
+    MultiSVMClassifier::Ptr train( const cv::Mat_<float> &xs, const cv::Mat_<int> &labels);
+
+    // Hit rate of the shared kernel cache over the last call to train.
+    inline double getCacheHitRate() const { return hitRate_;}
+
+private:
+    const SVMParams svmp_;
+    const MultiSVMClassifier::Scheme scheme_;
+    WorkerPool *workers_;
+    double hitRate_;
+
+    struct Problem
+    {
+        int posClass, negClass;     // Class indices (negClass -1 for one-vs-rest)
+        vector<uint> pos, neg;      // Global indices of the positive and negative examples
+        vector<double> posAlphas, negAlphas;    // Multipliers found
+        double b;                   // Threshold found
+        bool converged;
+    };  // end struct
+
+    vector<Problem> problems_;  // Binary problems of the current call to train
+    uint nextProblem_;          // Next problem to be handed out
+    boost::mutex mutex_;        // Guards nextProblem_
+
+    const cv::Mat_<float> *xs_;                             // Valid only during train()
+    SharedKernelCache<cv::Mat_<float> >::Ptr cache_;        // Valid only during train()
+
+    // Worker function training problems until there are none left.
+    void work( uint t);
+
+    MultiSVMTrainer( const MultiSVMTrainer&);             // No copy
+    MultiSVMTrainer& operator=( const MultiSVMTrainer&);  // No copy
+};  // end class
+
+}   // end namespace
+
+#endif
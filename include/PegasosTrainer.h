@@ -0,0 +1,119 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Streaming trainer for linear SVMs by mini-batch stochastic sub-gradient descent
+ * ("Pegasos: Primal Estimated sub-GrAdient SOlver for SVM", Shalev-Shwartz et al., 2007).
+ * Examples are pulled in mini-batches from a caller supplied source so the training
+ * set never needs to be held in memory, and memory use is O(d) besides the batches.
+ * Worker threads each pull their own batches and update a private copy of the weights
+ * (every Pegasos step rescales and projects the whole weight vector so the workers
+ * can't safely share one). After every SYNCBATCHES batches per worker the copies are
+ * averaged into the shared weights and training continues from the average (iterative
+ * parameter mixing, McDonald et al., 2010). As with LinearSVMTrainer, the threshold
+ * is learned as the weight on a constant feature.
+ *
+ * Richard Palmer
+ * 2017
+ */
+
+#pragma once
+#ifndef RLEARNING_PEGASOS_TRAINER_H
+#define RLEARNING_PEGASOS_TRAINER_H
+
+#include <vector>
+using std::vector;
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include "SVMClassifier.h"
+using RLearning::SVMClassifier;
+#include "WorkerPool.h"
+using RLearning::WorkerPool;
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+class PegasosTrainer
+{
+public:
+    // A source of training examples. Called with empty xs and ys vectors to append up
+    // to maxn examples to (with labels 1 for positive and -1 for negative). Returns the
+    // number of examples appended which should be zero once the stream is exhausted.
+    // The source is only ever called by one thread at a time.
+    typedef boost::function<uint (vector<cv::Mat_<float> >&, vector<int>&, uint)> Source;
+
+    // Train over examples with the given dimensions with regularisation weight lambda
+    // (corresponding to a misclassification cost of 1/(lambda*n) over n examples).
+    // Each update uses batchSize examples. A numThreads value of 0 uses all cores.
+    PegasosTrainer( const cv::Size &exampleDims, double lambda, uint batchSize=64, uint numThreads=0);
+    ~PegasosTrainer();
+
+    // Consume examples from the source until it's exhausted or at least maxExamples
+    // have been used (0 for no limit). May be called repeatedly with the same or
+    // different sources to continue training from the current weights.
+    void train( const Source &source, size_t maxExamples=0);
+
+    // Return a linear classifier from the current weights. May be called at any time
+    // including from another thread while train() is running.
+    SVMClassifier::Ptr snapshot() const;
+
+    // Set the weights back to zero.
+    void reset();
+
+    // Total number of examples and batches used since construction or reset().
+    size_t getNumExamples() const;
+    size_t getNumBatches() const;
+
+private:
+    const cv::Size xsize_;
+    const int dims_;
+    const double lambda_;
+    const uint batchSize_;
+    WorkerPool *workers_;
+
+    vector<double> w_;          // Averaged weights (with the bias weight last)
+    mutable boost::mutex wMutex_;   // Guards w_ against snapshot() during averaging
+    size_t steps_;              // Iteration count t of w_ for the step size 1/(lambda*t)
+    size_t numExamples_;
+    size_t numBatches_;
+    size_t numPos_, numNeg_;
+
+    vector<vector<double> > local_;     // Weights of each worker within a round
+    vector<size_t> localBatches_;       // Batches applied by each worker within a round
+
+    mutable boost::mutex srcMutex_; // Serialises calls to the source and the counters
+    const Source *source_;      // Valid only during train()
+    size_t maxExamples_;
+    bool exhausted_;            // Set once the source is exhausted (or maxExamples reached)
+
+    // Worker function pulling and applying up to SYNCBATCHES batches to local_[t].
+    void work( uint t);
+
+    static const double BIAS;   // Value of the constant feature appended to every example
+    static const uint SYNCBATCHES;  // Batches per worker between averaging
+
+    PegasosTrainer( const PegasosTrainer&);             // No copy
+    PegasosTrainer& operator=( const PegasosTrainer&);  // No copy
+};  // end class
+
+}   // end namespace
+
+#endif
@@ -15,6 +15,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ************************************************************************/
 
+#include "AlignedMatrix.h"
+#include "CancelToken.h"
+#include "CascadeSVMTrainer.h"
 #include "Classification.h"
 #include "CrossValidator.h"
 #include "CvModel.h"
@@ -24,21 +27,32 @@
 #include "FeatureDetector.h"
 #include "GaussianMAPEstimator.h"
 #include "KernelCache.h"
+#include "KernelFeatureMap.h"
 #include "KMeans.h"
 #include "KNearestClassifier.h"
 #include "KNearestNFoldCrossValidator.h"
 #include "KNearestRandomCrossValidator.h"
+#include "LinearSVMTrainer.h"
 #include "MAPEstimator.h"
 #include "Model.h"
+#include "MultiSVMClassifier.h"
+#include "MultiSVMTrainer.h"
 #include "NaiveBayesRandomCrossValidator.h""
 #include "NFoldCrossValidator.h"
 #include "PCA.h"
+#include "PegasosTrainer.h"
 #include "PrecisionRecallFinder.h"
 #include "RandomCrossValidator.h"
 #include "ROCFinder.h"
+#include "SharedKernelCache.h"
+#include "SparseMatrix.h"
 #include "SVMClassifier.h"
 #include "SVMNFoldCrossValidator.h"
 #include "SVMDataMiner.h"
 #include "SVMParams.h"
 #include "SVMTrainer.h"
+#include "SVMTrainingObserver.h"
+#include "TrainingView.h"
+#include "VectorOps.h"
 #include "ViewFeatureDetector.h"
+#include "WorkerPool.h"
@@ -28,10 +28,12 @@ using RLearning::NFoldCrossValidator;
 #include "SVMTrainer.h"
 #include "SVMClassifier.h"
 #include "KernelFunc.h"
+#include "SharedKernelCache.h"
 using RLearning::SVMParams;
 using RLearning::SVMTrainer;
 using RLearning::SVMClassifier;
 using RLearning::KernelFunc;
+using RLearning::SharedKernelCache;
 
 
 namespace RLearning
@@ -43,6 +45,9 @@ public:
     SVMBaggingNFoldCrossValidator( const SVMParams &svmp, int numClassifiers, int nfold,
             const cv::Mat_<float>& xs, const cv::Mat_<int> &labels, int numEVs=0);
 
+    // Hit rate of the kernel row cache shared by the bags over the last round of training.
+    inline double getCacheHitRate() const { return _hitRate;}
+
 protected:
     virtual void train( const cv::Mat_<float> &trainData, const cv::Mat_<int>& labels);
     virtual float validate( const cv::Mat_<float> &x);
@@ -53,10 +58,18 @@ private:
     double _eps;
     int _nfolds;
     int _numClassifiers;
+    double _cacheMB;        // Budget of the shared kernel row cache (0 for no limit)
+    int _numGroups;         // Groups of bags trained concurrently (splitting _cacheMB between their local caches)
+    double _hitRate;
+
+    // Kernel rows over the pool of positive then negative training examples shared by
+    // the trainers of all bags (only valid during train).
+    SharedKernelCache<cv::Mat_<float> >::Ptr _cache;
 
     vector<SVMClassifier::Ptr> _svmcs;
 
-    void trainGroup( int, int, const vector<cv::Mat_<float> >*, const vector<cv::Mat_<float> >*);
+    void trainGroup( int, int, const vector<cv::Mat_<float> >*, const vector<cv::Mat_<float> >*,
+                     const cv::Mat_<float>*);
 };  // end class
 
 }   // end namespace
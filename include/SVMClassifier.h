@@ -41,6 +41,8 @@ using std::getline;
 using RLearning::SVMParams;
 #include "KernelFunc.h"
 using RLearning::KernelFunc;
+#include "SparseMatrix.h"
+using RLearning::SparseRow;
 
 #include "Classification.h"
 
@@ -62,7 +64,7 @@ public:
     typedef boost::shared_ptr<SVMClassifier> Ptr;
     static Ptr create();
 
-    SVMClassifier(){}   // Enable loading from stream
+    SVMClassifier() : converged(true) {}   // Enable loading from stream
 
     // Before supplying 'as', ensure each of its elements has been
     // multipled by the correct class value : {-1,1}
@@ -73,11 +75,22 @@ public:
             double b, bool delVecs=true,   // Threshold and whether vectors should be deleted by object
             uint numPos=0, uint numNeg=0); // Number of positive and negative training examples used (not req.)
 
+    // Create a linear classifier directly from its weights (in the dimensions of the
+    // examples) and threshold as found by a trainer that keeps the weights explicitly
+    // (e.g. LinearSVMTrainer). The linear kernel must be specified in svmp. The number
+    // of support vectors is for information only since none are kept.
+    SVMClassifier( const SVMParams &svmp, const cv::Mat_<float> &w, double b,
+            uint numSVs=0, uint numPos=0, uint numNeg=0);
+
     virtual ~SVMClassifier();   // Deletes provided weight and example vectors unless delVecs=false in c'tor.
 
     // Returned value >= 0 denotes positive class and < 0 denotes negative class.
     virtual float predict( const cv::Mat_<float> &z) const;
 
+    // As above for a sparse example (e.g. a row of a SparseMatrix) of the same
+    // length as the training examples. Only the non-zeros of z are read.
+    float predict( const SparseRow &z) const;
+
     // Get/set the number of positive and negative examples used in training
     uint getNumPos() const { return numPos;}
     uint getNumNeg() const { return numNeg;}
@@ -96,6 +109,12 @@ public:
     double getThreshold() const { return b;}
     uint getNumSVs() const { return numSVs;}
 
+    // False if the trainer stopped before the optimality conditions were met (e.g. on
+    // an iteration or time limit) so this classifier is only an approximate solution.
+    // Not kept when written to or read from a stream (read classifiers are converged).
+    bool isConverged() const { return converged;}
+    void setConverged( bool c) { converged = c;}
+
     const SVMParams& getParams() const { return svmp;}
 
 private:
@@ -104,15 +123,19 @@ private:
     double b;       // Learned detection threshold
     uint numSVs;    // Length of *as and *xs (number of support vectors)
     cv::Mat_<float> linx;   // Only for linear classifier
+    vector<const float*> svps;  // Raw data of the support vectors (only for non-linear classifiers)
+    vector<double> svsqs;       // Squared norms of the support vectors (only for non-linear classifiers)
     bool delVecs;   // Deletes as and xs on destruction if true (see c'tor)
     uint numPos;    // Number of positive examples used for training (not req.)
     uint numNeg;    // Number of negative examples used for training (not req.)
+    bool converged; // False if training stopped early
 
     SVMParams svmp; // SVM parameters used to train this classifier
     KernelFunc<cv::Mat_<float> >::Ptr kernel;
 
     void deleteVectors();   // Deletes vectors only if delVecs == true
     void setKernel( const SVMParams&);
+    void setSupportVectorPointers();
 
     friend ostream& operator<<( ostream &os, const SVMClassifier &svmc);
     friend istream& operator>>( istream &is, SVMClassifier &svmc);
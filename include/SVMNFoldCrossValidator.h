@@ -45,6 +45,10 @@ public:
 
     int getNumSVs() const;
 
+    // Limit the training of each fold (see SVMTrainer::setMaxIterations, setTimeLimit and
+    // setCancelToken) so that hopeless parameter choices can be abandoned cheaply.
+    void setTrainingLimits( uint maxIterations, double maxSecs, const CancelToken::Ptr token=CancelToken::Ptr());
+
 protected:
     virtual void train( const cv::Mat_<float>& trainData, const cv::Mat_<int>& labels);
     virtual float validate( const cv::Mat_<float>& x);
@@ -53,6 +57,9 @@ private:
     const KernelFunc<cv::Mat_<float> >::Ptr _kernel;
     double _cost;
     double _eps;
+    uint _maxIts;
+    double _maxSecs;
+    CancelToken::Ptr _cancel;
     SVMClassifier::Ptr _svmc;
 };  // end class
 
@@ -82,6 +82,11 @@ public:
     void cost( double c) { cost_ = c;}
     void eps( double e) { eps_ = e;}
 
+    // Memory budget in MB for the kernel row cache used in training (0 for no limit).
+    // This isn't part of a trained model so it isn't read or written with the other params.
+    inline double cacheSize() const { return cacheSize_;}
+    void cacheSize( double mb) { cacheSize_ = mb;}
+
     // Kernel function parameters
     inline string kernel() const { return kernel_;}
     inline double gamma() const { return gamma_;}
@@ -108,6 +113,7 @@ private:
     double gamma_;
     double coef0_;
     double degree_;
+    double cacheSize_;
 
     friend std::istream &operator>>( std::istream &is, SVMParams &p) throw (InvalidKernelException);
 
@@ -26,6 +26,13 @@
  * Keerthi et al. (2001) (first order heuristic)
  * and Fan et al. (2005) (second order heuristic)
  *
+ * The template parameter V is the type kernel values are cached as. The default
+ * of float fits twice as many kernel rows within the cache budget as double and
+ * uses the vectorised prediction update. Caching as double keeps the kernel values
+ * at full precision (the kernels are still evaluated a batch at a time but the
+ * prediction update isn't vectorised) so serves as a precision reference. The
+ * predictions and multipliers are always kept in double.
+ *
  * Richard Palmer
  * May 2012
  */
@@ -38,18 +45,41 @@
 using std::vector;
 #include <algorithm>
 #include <boost/foreach.hpp>
-#include <boost/unordered_set.hpp>
-using boost::unordered_set;
 #include <boost/thread.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "SVMParams.h"
 using RLearning::SVMParams;
 #include "KernelCache.h"
 using RLearning::KernelCache;
+#include "SharedKernelCache.h"
+using RLearning::SharedKernelCache;
 #include "SVMClassifier.h"
 using RLearning::SVMClassifier;
+#include "WorkerPool.h"
+using RLearning::WorkerPool;
+#include "AlignedMatrix.h"
+using RLearning::AlignedMatrix;
+#include "LinearSVMTrainer.h"
+using RLearning::LinearSVMTrainer;
+#include "SVMTrainingObserver.h"
+using RLearning::SVMTrainingObserver;
+using RLearning::SVMTrainingProgress;
+#include "CancelToken.h"
+using RLearning::CancelToken;
+#include "SparseMatrix.h"
+using RLearning::SparseMatrix;
+using RLearning::SparseRow;
+#include "TrainingView.h"
+using RLearning::TrainingView;
+#include <sys/time.h>
+#include <string>
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
 using std::ostream;
 using std::istream;
 typedef unsigned int uint;
@@ -58,19 +88,25 @@ typedef unsigned int uint;
 namespace RLearning
 {
 
-template <typename T>
+template <typename T, typename V=float>
 class SVMTrainer
 {
 public:
-    static SVMClassifier::Ptr train( const vector<T> &pos, const vector<T> &neg, const SVMParams& svmp);
+    // Train a classifier by SMO with the given parameters. If useLinearSolver is true and the
+    // kernel is linear, LinearSVMTrainer is used instead. It's much faster but solves a slightly
+    // different problem (the threshold is regularised with the weights and there is no
+    // equality constraint) and stops after a fixed number of passes so the models differ.
+    static SVMClassifier::Ptr train( const vector<T> &pos, const vector<T> &neg, const SVMParams& svmp,
+                                     bool useLinearSolver=false);
 
     // maxThreads default of 0 causes training to use all available cores
     SVMTrainer( const SVMParams &p, uint maxThreads=0) throw (InvalidKernelException);
 
-    // maxThreads default of 0 causes training to use all available cores
+    // maxThreads default of 0 causes training to use all available cores.
+    // cacheMB gives the memory budget for the kernel row cache (0 for no limit).
     SVMTrainer( const typename KernelFunc<T>::Ptr kernel,
                 double cost=1e-1, double convTolerance=1e-3,
-                uint maxThreads=0);
+                uint maxThreads=0, double cacheMB=0);
 
     ~SVMTrainer();
 
@@ -79,55 +115,276 @@ public:
     // the same length (but should at least be similar in length).
     SVMClassifier::Ptr train( const vector<T> &pos, const vector<T> &neg);
 
+    // Train from sparse examples (one per row) with kernel values found over the non-zeros
+    // only. The matrices are used in place so must not change until training is done.
+    // The classifier returned keeps its support vectors dense so it can predict
+    // either dense or sparse examples. Not warm started by a later call to retrain().
+    SVMClassifier::Ptr train( const SparseMatrix &pos, const SparseMatrix &neg);
+
+    // Train over the examples of a view into a matrix in place. Nothing is copied (packed
+    // storage is not used) so the matrix and index spans mustn't change until training is
+    // done. The state kept per example is reused between calls to avoid reallocation.
+    // Not warm started by a later call to retrain().
+    SVMClassifier::Ptr train( const TrainingView &view);
+
+    // Warm started training. Optimisation continues from the given initial multipliers
+    // (one per positive and negative example) rather than from zero. The multipliers
+    // are first projected onto the feasible region (clamped to [0,cost] with the larger
+    // class sum scaled down so that the positive and negative sums are equal).
+    SVMClassifier::Ptr train( const vector<T> &pos, const vector<T> &neg,
+                              const vector<double> &posAlphas, const vector<double> &negAlphas);
+
+    // Warm started training from the multipliers found by the last call to train()
+    // or retrain() on this object. Examples are matched to those last trained on by
+    // identity (their data pointers) so examples held over from the last training set
+    // (e.g. as copies of the same matrix headers) resume from their old multipliers
+    // and new examples start from zero. Same as train( pos, neg) if never trained.
+    SVMClassifier::Ptr retrain( const vector<T> &pos, const vector<T> &neg);
+
+    // Get the multipliers found by the last training run (in the original order of the
+    // positive and negative examples). Useful for seeding a later warm started run.
+    void getAlphas( vector<double> &posAlphas, vector<double> &negAlphas) const;
+
+    // True iff an example with the given multiplier is a support vector (as kept by createClassifier).
+    static inline bool isSupportVector( double alpha) { return alpha > TAU;}
+
     // Enable or disable error output on the training iterations to show convergence.
     void enableErrorOutput( bool enable);
 
+    // Enable (default) or disable shrinking of the active set. When enabled, examples
+    // with multipliers stuck at a bound and that violate no KKT conditions are
+    // periodically dropped from the prediction updates and working set selection.
+    // They are brought back in (and their predictions reconstructed) before
+    // convergence over the whole training set is confirmed.
+    void enableShrinking( bool enable);
+
+    // Enable (default) or disable packing of the training examples into a single
+    // contiguous and aligned row-major buffer at the start of training. If disabled,
+    // the examples are used in place (and so must each be continuous in memory).
+    void enablePackedStorage( bool enable);
+
+    // Enable (default) or disable second order selection of the working set partner
+    // ("Working Set Selection Using Second Order Information for Training Support
+    // Vector Machines", Fan et al., 2005). If disabled, the maximal violating pair is
+    // used. Second order selection usually needs far fewer iterations to converge.
+    void enableSecondOrderSelection( bool enable);
+
+    // Return the number of SMO iterations (multiplier pair updates) made by the last training run.
+    inline uint getNumIterations() const { return numIts_;}
+
+    // Set an observer to be given the training progress every period iterations and
+    // once more on convergence (e.g. an SVMTrainingLogger). Set a null pointer to remove.
+    void setObserver( const SVMTrainingObserver::Ptr observer, uint period=100);
+
+    // Limit training to at most maxIterations SMO iterations and maxSecs seconds of wall
+    // clock time (zero for no limit which is the default for both) and stop as soon as
+    // the given token is cancelled (a null token for none). A run that stops early still
+    // returns a classifier from the current multipliers but with isConverged() false.
+    // At least one iteration is always made per run (even if the token is already cancelled
+    // or the time is up before SMO starts) so the classifier has support vectors.
+    void setMaxIterations( uint maxIterations);
+    void setTimeLimit( double maxSecs);
+    void setCancelToken( const CancelToken::Ptr token);
+
+    // True iff the last training run met the convergence tolerance (rather than stopping early).
+    inline bool isConverged() const { return converged_;}
+
+    // Write the solver state to fname every period iterations (and when training stops
+    // early) so that an interrupted run can be continued with resume(). The file is
+    // replaced atomically (written to fname.tmp first) so a run killed part way through
+    // writing leaves the last complete checkpoint. Set an empty filename to disable.
+    void setCheckpoint( const std::string &fname, uint period=10000);
+
+    // Continue the training run checkpointed to fname. The examples must be the same
+    // (and in the same order) as those given to the checkpointed run, and this trainer
+    // must have the same cost, tolerance and example weights (the bound on each example's
+    // multiplier is saved and checked). Kernel rows are not saved and are recalculated
+    // as needed. The iteration count (and so any iteration limit) carries on from the
+    // checkpoint. Returns a null pointer if the checkpoint can't be read or doesn't match.
+    SVMClassifier::Ptr resume( const std::string &fname, const vector<T> &pos, const vector<T> &neg);
+
+    // Gather kernel rows from a cache shared with other trainers (e.g. those training the
+    // binary problems of a MultiSVMTrainer) instead of calculating them. The global indices
+    // give the position in the shared cache's pool of each of the positive then negative
+    // examples given to the following train calls. Set a null cache to stop sharing.
+    void setSharedCache( const typename SharedKernelCache<T,V>::Ptr cache, const vector<uint> &globalIdxs);
+
+    // Spill kernel rows evicted from the in memory cache to a second tier of up to diskMB
+    // megabytes in a memory mapped scratch file created in directory dir (e.g. on a local
+    // SSD) so they're read back rather than recalculated. The file is removed at the end of
+    // each training run. An empty dir or a diskMB of 0 (the default) uses no second tier.
+    void setDiskCache( const std::string &dir, double diskMB);
+
+    // Weight the cost of each positive and negative example given to the following train calls
+    // (the upper bound on an example's multiplier becomes cost times its weight). Training with
+    // an example of integer weight w is equivalent to training with w copies of it (e.g. the
+    // duplicates of a bootstrap sample) but needs only the one kernel row and multiplier.
+    // Empty vectors (the default) weight every example by one.
+    void setExampleWeights( const vector<double> &posWeights, const vector<double> &negWeights);
+
+    // Enable or disable (default) finding the whole kernel matrix of the training examples
+    // up front (as a blocked matrix product over all threads) rather than filling the kernel
+    // cache a row at a time as SMO needs them. Faster for problems small enough for the
+    // n x n matrix (of V) to fit in memory. Rows are then read from the matrix in place
+    // of the kernel row cache. Ignored for sparse examples or if a shared cache is set.
+    void enablePrecomputedKernel( bool enable);
+
+    // Train over the given (symmetric) kernel matrix of the positive then negative examples
+    // given to the following train calls instead of evaluating the kernel (e.g. for a custom
+    // kernel). The kernel given on construction is still used by the classifier returned
+    // so should match. Same as setSharedCache with a full cache over the matrix.
+    void setGramMatrix( const cv::Mat_<V> &gram);
+
 private:
     uint MAXTHREADS;
     const double COST;            // Cost weighting on misclassified training data
     const double EPS;             // Convergence tolerance (typically 0.001 or 0.0001)
+    const double CACHEMB;         // Kernel cache memory budget in MB (0 for no limit)
     const typename KernelFunc<T>::Ptr kernel;   // Kernel function (linear, polynomial, gaussian etc)
 
-    KernelCache<T> *kernelCache;  // Kernel cache
+    KernelCache<T,V> *kernelCache;  // Kernel cache
+    WorkerPool *workers;          // Long-lived threads for updatePredictions (MAXTHREADS in size)
     bool enableErrOut_;           // If true, error output (convergence info) displayed
-    vector<T> xs;                 // The training instances themselves (negative instances start at negZero)
+    bool packed_;                 // If true, training instances are copied into xmat
+    bool shrinking_;              // If true, the active set is shrunk periodically
+    bool secondOrder_;            // If true, the working set partner is chosen by second order information
+    uint numIts_;                 // Iterations made in the last training run
+    SVMTrainingObserver::Ptr observer_;  // Given progress reports if set
+    uint obsPeriod_;              // Iterations between progress reports
+    struct timeval startTime_;    // Start of the current training run
+    size_t kernelEvals_;          // Kernel evaluations made outside of the cache in the current run
+    size_t gathered_;             // Kernel values taken from shared_ in the current run
+    uint maxIts_;                 // Most iterations per run (0 for no limit)
+    double maxSecs_;              // Most seconds per run (0 for no limit)
+    CancelToken::Ptr cancel_;     // Stops training once cancelled (if set)
+    bool converged_;              // True iff the last run converged
+    std::string ckptFile_;        // Solver state written here if not empty
+    uint ckptPeriod_;             // Iterations between checkpoints
+    bool precompute_;             // Find the whole kernel matrix up front
+    std::string diskDir_;         // Directory of the kernel cache's second tier (if set)
+    double diskMB_;               // Size of the kernel cache's second tier
+    vector<double> weights_;      // Cost weight per example (pos then neg) as set by setExampleWeights
+    typename SharedKernelCache<T,V>::Ptr sharedCache_;  // As set by setSharedCache
+    typename SharedKernelCache<T,V>::Ptr shared_;  // Kernel rows gathered (or read in place if gram_) from here if set (sharedCache_ or the precomputed matrix)
+    vector<uint> sharedIdxs_;     // Index into the shared cache of each example (pos then neg)
+    AlignedMatrix xmat;           // Packed training instances (one per row, negative instances start at row negZero)
+    vector<const float*> xs;      // The training instances as raw rows (negative instances start at negZero; NULL if sparse_)
+    vector<SparseRow> sxs;        // The training instances if sparse_
+    bool sparse_;                 // True if training on sparse instances
+    int dims;                     // Length of each training instance
+    cv::Size xsize;               // Matrix dimensions of each training instance
     vector<double> alphas;        // Lagrange multipliers for each training example
     vector<double> fns;           // Current prediction per training instance
-    unordered_set<uint> highIdxs; // High index set
-    unordered_set<uint> lowIdxs;  // Low index set
-    uint negZero;                 // Zero index to the first negative example in xs, alphas and fns.
+    vector<double> cs;            // Upper bound on each multiplier (COST times the example's weight)
+    vector<double> diag;          // Kernel diagonal K(x_i,x_i) per training instance
+    vector<double> sqnorms;       // Squared norm per training instance (for distance based kernels)
+    vector<int> ys;               // Target value per training instance
+    vector<uint> order;           // Original index of each training instance (shrinking reorders them)
+    vector<uint> gidx;            // Index into the shared cache of each training instance (if shared_)
+    bool gram_;                   // True if shared_ holds the whole kernel matrix (kernelCache isn't used)
+    vector<unsigned char> status; // Per instance membership of the high and low index sets (IN_HIGH|IN_LOW)
+    uint negZero;                 // Zero index to the first negative example (before any reordering)
+    uint activeSize;              // Instances [0,activeSize) are active (not shrunk)
+    bool unshrunk_;               // True once predictions reconstructed close to convergence
+    boost::unordered_map<const void*, double> seeds_;  // Non-zero multipliers from the last run keyed by example data
+
+    enum { IN_HIGH = 1, IN_LOW = 2};    // Index set membership flags in status
 
     struct Alpha;    // An indexed alpha (Lagrange multiplier)
+    struct Extrema;  // Per worker min/max functional predictions over the high/low index sets
+    vector<Extrema> extrema;      // One per worker so reductions need no locking
 
     void optimise( Alpha &high, Alpha &low, double bDiff);
 
-    // Constrain provided alpha within the allowable region >= 0.0 and <= COST
-    double constrainAlpha( double a);
+    // Constrain provided alpha of example idx within the allowable region >= 0.0 and <= cs[idx]
+    double constrainAlpha( double a, uint idx) const;
 
     // Update current functional predictions as well as the first order heuristic
     // for selecting the next pair of alphas to update.
     void updatePredictions( Alpha &high, Alpha &low, double &bHigh, double &bLow);
 
-    // The second order heuristic for selection of the working set partner will normally
-    // result in fewer iterations to convergence but at the cost of greater processing time.
-    // Original algorithm in "Working Set Selection Using Second Order Information for
-    // Training Support Vector Machines", Fan et al., 2005.
-    uint selectSecondOrderPartner( const uint i) const;
+    // Return the working set partner of i (from the low index set) giving the greatest
+    // decrease in the objective using second order information (Fan et al., 2005).
+    // The kernel row of i is filled over the active set in the same parallel pass so
+    // that it's already cached for the next updatePredictions. Returns j if no partner
+    // is found.
+    uint selectSecondOrderPartner( uint i, uint j);
 
     // Update membership of the high and low index sets.
     void updateIndexSets( const double alpha, const uint idx);
 
+    // Number of worker segments to split a pass over len examples into.
+    uint numSegments( uint len) const;
+
+    // Reduce the per worker extrema from the last pass over nsegs segments.
+    void reduceExtrema( uint nsegs, uint &nextHigh, double &bHigh, uint &nextLow, double &bLow) const;
+
+    // True iff the example at idx is at a bound and can't currently violate the KKT conditions.
+    bool isShrinkable( uint idx, double bHigh, double bLow) const;
+
+    // Move shrinkable examples to the end of the active set and reduce its size. The first
+    // time close to convergence this first unshrinks (updating bHigh and bLow over all examples).
+    void doShrinking( Alpha &high, Alpha &low, double &bHigh, double &bLow);
+
+    // Reconstruct the predictions of the inactive examples, make all examples
+    // active again and reset the working set pair and bHigh and bLow over all examples.
+    void unshrink( Alpha &high, Alpha &low, double &bHigh, double &bLow);
+
+    // Swap the positions of two training examples (and all their state).
+    void swapIndex( uint i, uint j);
+
+    // Give the observer the current progress.
+    void reportProgress( double bHigh, double bLow, bool converged) const;
+
+    // True iff an iteration or time limit has been reached or training has been cancelled.
+    bool stopEarly() const;
+
+    // Seconds since the start of the current training run.
+    double elapsedSecs() const;
+
     // Create and return a new classifier encapsulating the trained weights.
     SVMClassifier::Ptr createClassifier( double threshold) const;
 
     void reset( const vector<T> &pos, const vector<T> &neg);
+    void resetSparse( const SparseMatrix &pos, const SparseMatrix &neg);
+    void resetView( const TrainingView &view);
+
+    // Set the per instance state (alphas, predictions, kernel diagonal etc) for xs.size()
+    // instances (or sxs if sparse_) and create the kernel cache.
+    void initState();
+
+    // Keep the non-zero multipliers to warm start a later call to retrain().
+    void keepSeeds( const vector<T> &pos, const vector<T> &neg);
+
+    // Train from initAlphas (ordered as pos then neg) or from zero if NULL.
+    SVMClassifier::Ptr trainFrom( const vector<T> &pos, const vector<T> &neg, const vector<double> *initAlphas);
+
+    // Run SMO from the current state (set up by trainFrom or resume) until converged
+    // or stopped early and return the classifier.
+    SVMClassifier::Ptr solve( Alpha &ah, Alpha &al, double bHigh, double bLow);
+
+    // Write the solver state to ckptFile_ returning false (with an error message) on failure.
+    bool writeCheckpoint() const;
+
+    // Restore the solver state from fname into this trainer (already reset over the same
+    // examples) returning false (with an error message) if it can't be read or doesn't match.
+    bool readCheckpoint( const std::string &fname);
+
+    // Project initAlphas onto the feasible region and set them as the starting multipliers.
+    void setInitialAlphas( const vector<double> &initAlphas);
 
     // Return the target value (positive = 1, negative = -1) for the example with given index.
     int target( uint idx) const;
 
     class ThreadFn; // Function object for multi-threaded updatePredictions()
+    class ReconstructFn; // Function object for multi-threaded unshrink()
+    class SelectFn; // Function object for multi-threaded selectSecondOrderPartner()
 
-    static const double TAU;    // Very small positive number
+    static const double TAU;    // Very small positive number (multipliers above it are support vectors)
+    static const uint MINSEGSIZE; // Fewest examples per worker before updatePredictions runs in parallel
+    static const uint SHRINKPERIOD; // Most iterations between shrinking the active set
+    static const uint TIMECHECKPERIOD; // Iterations between checks of the time limit
+    static const char CKPTMAGIC[8];    // Identifies a checkpoint file (includes the format version)
 };  // end class SVMTrainer
 
 #include "template/SVMTrainer_template.h"
@@ -0,0 +1,85 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Observer interface for following the progress of SMO training by SVMTrainer
+ * along with SVMTrainingLogger which writes each progress report to a stream
+ * as a line of CSV or JSON. The trainer only builds a report every given number
+ * of iterations and only if an observer is set, so otherwise it costs nothing.
+ */
+
+#pragma once
+#ifndef RLEARNING_SVM_TRAINING_OBSERVER_H
+#define RLEARNING_SVM_TRAINING_OBSERVER_H
+
+#include <cstddef>
+#include <iostream>
+#include <boost/shared_ptr.hpp>
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+struct SVMTrainingProgress
+{
+    uint iteration;         // SMO iterations made so far
+    double gap;             // Duality gap bLow - bHigh (converged once below the tolerance)
+    uint activeSize;        // Examples in the active (unshrunk) set
+    uint numExamples;       // Total number of training examples
+    double cacheHitRate;    // Hit rate of the trainer's own kernel row cache so far
+    size_t kernelEvals;     // Kernel function evaluations made so far
+    size_t gatheredValues;  // Kernel values copied from a shared cache or kernel matrix so far (not evaluations)
+    double msecs;           // Elapsed training time in milliseconds
+    bool converged;         // True only for the final report of a run
+};  // end struct
+
+
+class SVMTrainingObserver
+{
+public:
+    typedef boost::shared_ptr<SVMTrainingObserver> Ptr;
+    virtual ~SVMTrainingObserver(){}
+
+    // Called on the training thread at the set cadence and once more when training finishes.
+    virtual void progress( const SVMTrainingProgress&) = 0;
+};  // end class
+
+
+class SVMTrainingLogger : public SVMTrainingObserver
+{
+public:
+    enum Format
+    {
+        CSV,    // Comma separated values with a header line before the first report
+        JSON    // One JSON object per line
+    };  // end enum
+
+    // The stream must outlive this object.
+    explicit SVMTrainingLogger( std::ostream &os, Format fmt=CSV);
+
+    virtual void progress( const SVMTrainingProgress&);
+
+private:
+    std::ostream &os_;
+    const Format fmt_;
+    bool wroteHeader_;
+};  // end class
+
+}   // end namespace
+
+#endif
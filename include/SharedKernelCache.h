@@ -0,0 +1,146 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Thread safe cache of whole kernel function rows over a fixed pool of examples
+ * for sharing between many SVMTrainers training on subsets of the same pool at
+ * the same time (e.g. the binary problems of a multi-class SVM). Rows are keyed
+ * by the example's global index into the pool and hold K(x_i,x_k) for every
+ * example k in the pool. A row is calculated in full by the first thread to ask
+ * for it and held (within a memory budget with least recently used eviction)
+ * for any other thread to read. Rows are handed out as shared pointers so that
+ * eviction never frees a row still being read. To keep threads asking for
+ * different rows from contending for a single lock, rows are spread over a
+ * fixed number of shards (by index) each with its own lock, least recently used
+ * list and equal share of the memory budget.
+ *
+ * For pools small enough for the whole n x n kernel matrix to fit in memory the
+ * cache can instead be filled up front, either from a matrix given by the caller
+ * (e.g. of a custom kernel) or by precompute() which finds it as a cache blocked
+ * matrix product over many threads. Rows of a full cache are never evicted and are
+ * read without locking.
+ */
+
+#pragma once
+#ifndef RLearning_SHARED_KERNEL_CACHE
+#define RLearning_SHARED_KERNEL_CACHE
+
+#include "KernelFunc.h"
+using RLearning::KernelFunc;
+#include <vector>
+using std::vector;
+#include <cstddef>
+#include <cassert>
+#include <utility>
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
+#include <boost/ref.hpp>
+#include <boost/thread/mutex.hpp>
+#include <opencv2/opencv.hpp>
+#include "WorkerPool.h"
+using RLearning::WorkerPool;
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+template <typename T, typename V=float>
+class SharedKernelCache
+{
+public:
+    typedef boost::shared_ptr<SharedKernelCache<T,V> > Ptr;
+    typedef boost::shared_ptr<const vector<V> > Row;
+
+    // Cache rows over the examples xs (each a raw vector of length dims that must
+    // outlive this object) using at most cacheMB megabytes (0 for no limit).
+    SharedKernelCache( const typename KernelFunc<T>::Ptr kernel,
+                       const vector<const float*> &xs, int dims, double cacheMB=0);
+
+    // Hold the whole n x n kernel matrix gram (symmetric) of a pool of n examples as given
+    // by the caller. The kernel function is only kept to be returned from getKernel().
+    SharedKernelCache( const typename KernelFunc<T>::Ptr kernel, const cv::Mat_<V> &gram);
+
+    // Create a cache holding the whole kernel matrix over xs found up front. The matrix is
+    // filled a tile of BLOCK x BLOCK entries at a time (only those on or above the diagonal
+    // with each mirrored below) so the examples of a tile stay in cache while it's filled.
+    // Tiles are shared out over the threads of the given pool (e.g. the trainer's own).
+    static Ptr precompute( const typename KernelFunc<T>::Ptr kernel,
+                           const vector<const float*> &xs, int dims, WorkerPool &workers);
+
+    // True iff the whole kernel matrix is held (so row() never calculates or evicts).
+    inline bool isPrecomputed() const { return precomputed_;}
+
+    // Return the row of example i (calculating it if not held). May be called
+    // concurrently from many threads. Rows being calculated by one thread are not
+    // waited on by others asking for the same row; they calculate it too.
+    Row row( uint i);
+
+    // Number of examples in the pool (length of each row).
+    inline uint size() const { return uint(rows_.size());}
+
+    // Maximum number of rows held at once.
+    inline uint maxRows() const { return maxRows_;}
+
+    // Return the kernel function object used for this cache.
+    inline typename KernelFunc<T>::Ptr getKernel() const { return kernel;}
+
+    // Lookup statistics for row() calls (not counted if the whole matrix is held).
+    size_t hits() const;
+    size_t misses() const;
+    double hitRate() const;
+
+private:
+    const typename KernelFunc<T>::Ptr kernel;
+    const vector<const float*> xs_;
+    vector<double> sqnorms_;    // Squared norm per example
+    const int dims_;
+    uint maxRows_;
+    vector<Row> rows_;          // Cached rows (null if not resident)
+    vector<int> prev_;          // LRU doubly linked lists over the resident rows of each shard
+    vector<int> next_;          // (element size()+s is the head of shard s; next_ is towards least recently used)
+    bool precomputed_;
+
+    enum { NUMSHARDS = 16};     // Row i belongs to shard i % NUMSHARDS
+    struct Shard
+    {
+        uint maxRows;
+        uint numRows;
+        size_t hits, misses;
+        mutable boost::mutex mutex;     // Guards the shard's rows, list and counts
+        Shard() : maxRows(0), numRows(0), hits(0), misses(0) {}
+    };  // end struct
+    Shard shards_[NUMSHARDS];
+
+    enum { BLOCK = 64}; // Tile size (rows and columns) used by precompute
+    class GramFn;
+
+    // Set the budget of each shard and empty their lists.
+    void initShards();
+
+    void unlink( uint i);
+    void pushFront( uint i);
+
+    SharedKernelCache( const SharedKernelCache&);             // No copy
+    SharedKernelCache& operator=( const SharedKernelCache&);  // No copy
+};  // end class SharedKernelCache
+
+#include "template/SharedKernelCache_template.h"
+
+}   // end namespace
+
+#endif
@@ -0,0 +1,103 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Sparse float matrix in compressed sparse row (CSR) form with one example per row.
+ * Only the non-zero entries of each row are held (as ascending column indices and
+ * their values) so examples that are mostly zero (e.g. thresholded histograms)
+ * take memory and kernel evaluation time in proportion to their non-zeros rather
+ * than their dimension. Rows are read through SparseRow views which stay valid
+ * until more rows are added to the matrix.
+ */
+
+#pragma once
+#ifndef RLEARNING_SPARSE_MATRIX_H
+#define RLEARNING_SPARSE_MATRIX_H
+
+#include <vector>
+using std::vector;
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+// View of one sparse row: nnz non-zero values at ascending column indices.
+struct SparseRow
+{
+    const uint *idx;
+    const float *val;
+    uint nnz;
+
+    SparseRow() : idx(NULL), val(NULL), nnz(0) {}
+    SparseRow( const uint *i, const float *v, uint n) : idx(i), val(v), nnz(n) {}
+};  // end struct
+
+
+class SparseMatrix
+{
+public:
+    // Create an empty matrix with rows of length cols.
+    explicit SparseMatrix( int cols=0);
+
+    // Create from the rows of dense matrix m (only its non-zero entries are kept).
+    explicit SparseMatrix( const cv::Mat_<float> &m);
+
+    // Append a row from the non-zero entries of dense vector x (of length cols()).
+    void addRow( const cv::Mat_<float> &x);
+
+    // Append a row of nnz entries (column indices must be ascending and less than cols()).
+    void addRow( const uint *idx, const float *val, uint nnz);
+
+    inline int rows() const { return int(rowStart_.size()) - 1;}
+    inline int cols() const { return cols_;}
+    inline size_t nnz() const { return vals_.size();}
+
+    // Return a view of row i.
+    inline SparseRow row( int i) const
+    {
+        const uint s = rowStart_[i];
+        if ( vals_.empty())
+            return SparseRow();
+        return SparseRow( &colIdx_[0] + s, &vals_[0] + s, rowStart_[i+1] - s);
+    }   // end row
+
+    // Return row i as a dense 1 x cols() vector.
+    cv::Mat_<float> toDense( int i) const;
+
+private:
+    int cols_;
+    vector<uint> rowStart_;     // Offset of each row into colIdx_ and vals_ (with the total last)
+    vector<uint> colIdx_;
+    vector<float> vals_;
+};  // end class
+
+
+// Inner product of two sparse rows (merges the non-zeros of both).
+double sparseDot( const SparseRow &x1, const SparseRow &x2);
+
+// Inner product of a sparse row with a dense vector (gathers at the non-zeros of x).
+double sparseDot( const SparseRow &x, const float *d);
+
+// Squared norm of a sparse row.
+double sparseSqNorm( const SparseRow &x);
+
+}   // end namespace
+
+#endif
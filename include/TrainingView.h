@@ -0,0 +1,69 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Non-owning view of a training set held as rows of a single row-major float
+ * matrix (e.g. a pool of examples shared by many trainers when bagging or cross
+ * validating). The positive and negative examples are given as spans of row
+ * indices into the matrix so that a subset can be trained on in place without
+ * the examples being copied. The matrix and both index spans must outlive any
+ * training using the view.
+ */
+
+#pragma once
+#ifndef RLEARNING_TRAINING_VIEW_H
+#define RLEARNING_TRAINING_VIEW_H
+
+#include <vector>
+using std::vector;
+#include <cstddef>
+#include <opencv2/opencv.hpp>
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+struct TrainingView
+{
+    const float *data;      // First element of the first row
+    size_t stride;          // Floats between the starts of consecutive rows
+    int dims;               // Length of each example
+    const uint *posIdx;     // Rows of the positive examples
+    uint numPos;
+    const uint *negIdx;     // Rows of the negative examples
+    uint numNeg;
+
+    TrainingView() : data(NULL), stride(0), dims(0), posIdx(NULL), numPos(0), negIdx(NULL), numNeg(0) {}
+
+    // View the rows of xs (CV_32FC1 with each row continuous) given by posIdx and negIdx.
+    TrainingView( const cv::Mat_<float> &xs, const vector<uint> &pidxs, const vector<uint> &nidxs)
+        : data( xs.ptr<float>(0)), stride( xs.step1()), dims( xs.cols),
+          posIdx( pidxs.empty() ? NULL : &pidxs[0]), numPos( uint(pidxs.size())),
+          negIdx( nidxs.empty() ? NULL : &nidxs[0]), numNeg( uint(nidxs.size())) {}
+
+    // Raw data of example i (i < numPos for the positives then the negatives).
+    inline const float* example( uint i) const
+    {
+        const uint r = i < numPos ? posIdx[i] : negIdx[i - numPos];
+        return data + r * stride;
+    }   // end example
+};  // end struct
+
+}   // end namespace
+
+#endif
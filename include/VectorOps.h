@@ -0,0 +1,100 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Vectorised primitives over raw float arrays used by the kernel functions and
+ * SVMTrainer. Each function has AVX-512, AVX2 (with FMA) and scalar versions with
+ * the best supported by the CPU chosen once at load time. Arrays don't need to be
+ * aligned or of any particular length. Products of two float vectors are accumulated
+ * in double in a fixed order so that the single and paired versions of a function and
+ * the versions for each instruction set give identical results. Products with double
+ * vectors are also accumulated in double.
+ */
+
+#pragma once
+#ifndef RLEARNING_VECTOR_OPS_H
+#define RLEARNING_VECTOR_OPS_H
+
+#include <string>
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+// Inner product of two float vectors of length n.
+double dotProduct( const float *x1, const float *x2, int n);
+
+// Squared Euclidean distance between two float vectors of length n.
+double sqDistance( const float *x1, const float *x2, int n);
+
+// Set di = xi.xk and dj = xj.xk reading xk only once.
+void dotProduct2( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj);
+
+// Set di = |xi-xk|^2 and dj = |xj-xk|^2 reading xk only once.
+void sqDistance2( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj);
+
+// Batch versions of dotProduct2 and sqDistance2 over the nks vectors in xks writing the
+// results for xi to di[0..nks) and for xj to dj[0..nks). If xj is NULL, only di is set.
+// The instruction set is dispatched once per batch rather than once per vector.
+void dotProductRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                     float *di, float *dj);
+void sqDistanceRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                     float *di, float *dj);
+
+// As above writing the results without rounding them to float.
+void dotProductRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                     double *di, double *dj);
+void sqDistanceRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                     double *di, double *dj);
+
+// The SMO prediction update and first order working set search fused into one pass.
+// For k in [k0,k1) set fns[k] += ai*ri[k] + aj*rj[k] and find the smallest fns[k]
+// over the k with (status[k] & highFlag) and the largest fns[k] over the k with
+// (status[k] & lowFlag). minf/minIdx and maxf/maxIdx are only changed if a smaller
+// (or larger) value is found and ties go to the lowest index.
+void updateAndSearch( double *fns, const float *ri, const float *rj, double ai, double aj,
+                      const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                      uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx);
+
+// As above for double precision kernel rows (not vectorised).
+void updateAndSearch( double *fns, const double *ri, const double *rj, double ai, double aj,
+                      const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                      uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx);
+
+// As above reading the kernel values of example k at ri[idx[k]] and rj[idx[k]] so that
+// rows of a kernel matrix over the examples in some other order are read in place
+// rather than gathered first (not vectorised).
+void updateAndSearch( double *fns, const float *ri, const float *rj, const uint *idx, double ai, double aj,
+                      const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                      uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx);
+void updateAndSearch( double *fns, const double *ri, const double *rj, const uint *idx, double ai, double aj,
+                      const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                      uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx);
+
+// Inner product of a double vector (e.g. weights) with a float vector of length n.
+double dotProduct( const double *w, const float *x, int n);
+
+// Set w += a*x over the n elements of w and x.
+void addScaled( double *w, double a, const float *x, int n);
+
+// Name of the instruction set in use ("avx512", "avx2" or "scalar").
+std::string vectorOpsInstructionSet();
+
+}   // end namespace
+
+#endif
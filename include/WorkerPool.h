@@ -0,0 +1,73 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * A fixed group of long-lived worker threads for running many short parallel
+ * jobs in succession (e.g. one per SMO iteration) without paying for thread
+ * creation and teardown on every job. The thread calling run() takes part as
+ * worker 0, so a pool of size N starts only N-1 threads. Handoff between the
+ * caller and the workers is done with a start and a finish barrier per job.
+ */
+
+#pragma once
+#ifndef RLEARNING_WORKER_POOL_H
+#define RLEARNING_WORKER_POOL_H
+
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/function.hpp>
+typedef unsigned int uint;
+
+
+namespace RLearning
+{
+
+class WorkerPool
+{
+public:
+    typedef boost::function<void (uint)> Job;
+
+    // Create a pool of numThreads workers (including the calling thread).
+    // A numThreads value of 0 causes the pool to use all available cores.
+    explicit WorkerPool( uint numThreads=0);
+    ~WorkerPool();  // Stops and joins all workers
+
+    // Number of workers (including the calling thread).
+    inline uint size() const { return _nthreads;}
+
+    // Run job(t) on every worker t in [0,size()) and return once all are finished.
+    // The calling thread runs job(0). Job objects are not copied so pass in
+    // functors with boost::ref to avoid allocation. Call from one thread only.
+    void run( const Job &job);
+
+private:
+    uint _nthreads;
+    boost::thread_group _workers;
+    boost::barrier *_start;     // Workers wait here for the next job
+    boost::barrier *_finish;    // Workers wait here after finishing their part of a job
+    const Job *_job;            // Current job (only valid between barriers)
+    bool _stop;                 // Set to true on destruction to exit the workers
+
+    void work( uint t);
+
+    WorkerPool( const WorkerPool&);             // No copy
+    WorkerPool& operator=( const WorkerPool&);  // No copy
+};  // end class
+
+}   // end namespace
+
+#endif
@@ -15,27 +15,311 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  ************************************************************************/
 
-template <typename T>
-KernelCache<T>::KernelCache( const typename KernelFunc<T>::Ptr kf, size_t sz)
-    : kernel(kf), vals( new SymmetricMatrix<double>( sz)), flags( new SymmetricBitSet( sz))
-{}   // end ctor
+template <typename T, typename V>
+KernelCache<T,V>::KernelCache( const typename KernelFunc<T>::Ptr kf, size_t sz, double cacheMB)
+    : kernel(kf), sz_(sz), maxRows_(sz), numRows_(0),
+      rows_( sz, (V*)NULL), filled_( sz, 0), prev_( sz+1), next_( sz+1), hits_(0), misses_(0), evals_(0),
+      maxDiskRows_(0), disk_(NULL), diskBytes_(0), diskHits_(0)
+{
+    if ( cacheMB > 0)
+    {
+        const double rowBytes = double(sz) * sizeof(V);
+        const double nrows = cacheMB * 1024 * 1024 / rowBytes;
+        if ( nrows < maxRows_)
+            maxRows_ = uint(nrows);
+    }   // end if
+    if ( maxRows_ < 2)
+        maxRows_ = 2;
+
+    prev_[sz_] = next_[sz_] = sz_;  // Empty list
+}   // end ctor
 
 
-template <typename T>
-KernelCache<T>::~KernelCache()
+template <typename T, typename V>
+KernelCache<T,V>::~KernelCache()
 {
-    delete vals;
-    delete flags;
+    for ( size_t i = 0; i < rows_.size(); ++i)
+        delete[] rows_[i];
+    if ( disk_ != NULL)
+        munmap( disk_, diskBytes_);
 }   // end dtor
 
 
-template <typename T>
-double KernelCache<T>::krn( uint i, const T &xi, uint j, const T &xj)
+template <typename T, typename V>
+bool KernelCache<T,V>::enableDiskTier( const std::string &dir, double diskMB)
+{
+    assert( disk_ == NULL);
+    const double rowBytes = double(sz_) * sizeof(V);
+    const double nrows = std::min( diskMB * 1024 * 1024 / rowBytes, double(sz_));
+    if ( nrows < 1)
+        return false;
+
+    std::string fname = dir + "/rlkcacheXXXXXX";
+    vector<char> tmpl( fname.begin(), fname.end());
+    tmpl.push_back('\0');
+    const int fd = mkstemp( &tmpl[0]);
+    if ( fd < 0)
+    {
+        std::cerr << "Unable to create kernel cache scratch file in " << dir << std::endl;
+        return false;
+    }   // end if
+    ::unlink( &tmpl[0]);    // Removed once unmapped
+
+    const size_t bytes = size_t(nrows) * sz_ * sizeof(V);
+    void *m = MAP_FAILED;
+    if ( ftruncate( fd, bytes) == 0)
+        m = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close( fd);
+    if ( m == MAP_FAILED)
+    {
+        std::cerr << "Unable to map " << bytes << " bytes of kernel cache scratch file in " << dir << std::endl;
+        return false;
+    }   // end if
+
+    disk_ = static_cast<char*>(m);
+    diskBytes_ = bytes;
+    maxDiskRows_ = uint(nrows);
+    slot_.assign( sz_, -1);
+    diskFilled_.assign( sz_, 0);
+    freeSlots_.resize( maxDiskRows_);
+    for ( uint s = 0; s < maxDiskRows_; ++s)
+        freeSlots_[s] = int(maxDiskRows_ - s - 1);
+    dprev_.resize( sz_+1);
+    dnext_.resize( sz_+1);
+    dprev_[sz_] = dnext_[sz_] = sz_;    // Empty list
+    return true;
+}   // end enableDiskTier
+
+
+template <typename T, typename V>
+double KernelCache<T,V>::hitRate() const
 {
-    if (flags->isSet( i,j)) // Return cached result if available
-        return vals->get(i,j);
-    double v = (*kernel)( xi, xj);  // Expensive...
-    vals->set(i,j,v);   // ... so cache!
-    flags->set(i,j);
+    const size_t lookups = hits_ + misses_;
+    return lookups > 0 ? double(hits_)/lookups : 0;
+}   // end hitRate
+
+
+template <typename T, typename V>
+bool KernelCache<T,V>::cached( uint i, uint j, double &v) const
+{
+    if ( rows_[i] != NULL && filled_[i] > j)
+    {
+        v = rows_[i][j];
+        return true;
+    }   // end if
+    if ( rows_[j] != NULL && filled_[j] > i)
+    {
+        v = rows_[j][i];
+        return true;
+    }   // end if
+    return false;
+}   // end cached
+
+
+template <typename T, typename V>
+double KernelCache<T,V>::krn( uint i, const T &xi, uint j, const T &xj)
+{
+    double v;
+    if ( cached( i, j, v))
+    {
+        hits_++;
+        return v;
+    }   // end if
+    misses_++;
+    evals_++;
+    return (*kernel)( xi, xj);
+}   // end krn
+
+
+template <typename T, typename V>
+double KernelCache<T,V>::krn( uint i, const float *xi, uint j, const float *xj, int n)
+{
+    double v;
+    if ( cached( i, j, v))
+    {
+        hits_++;
+        return v;
+    }   // end if
+    misses_++;
+    evals_++;
+    return (*kernel)( xi, xj, n);
+}   // end krn
+
+
+template <typename T, typename V>
+double KernelCache<T,V>::krn( uint i, const SparseRow &xi, double sqi, uint j, const SparseRow &xj, double sqj)
+{
+    double v;
+    if ( cached( i, j, v))
+    {
+        hits_++;
+        return v;
+    }   // end if
+    misses_++;
+    evals_++;
+    kernel->sparseRow( xi, sqi, &xj, &sqj, 1, &v);
     return v;
 }   // end krn
+
+
+template <typename T, typename V>
+V* KernelCache<T,V>::row( uint i, uint &filled)
+{
+    if ( rows_[i] != NULL)
+    {
+        hits_++;
+        unlink(i);
+        pushFront(i);
+        filled = filled_[i];
+        return rows_[i];
+    }   // end if
+
+    misses_++;
+    V *r = NULL;
+    if ( numRows_ < maxRows_)
+    {
+        r = new V[sz_];
+        numRows_++;
+    }   // end if
+    else
+    {   // Take over the memory of the least recently used row
+        const uint lru = prev_[sz_];
+        unlink( lru);
+        r = rows_[lru];
+        spill( lru, r, filled_[lru]);
+        rows_[lru] = NULL;
+        filled_[lru] = 0;
+    }   // end else
+
+    filled = 0;
+    if ( disk_ != NULL && slot_[i] >= 0)
+    {   // Copy back from the second tier (freeing its slot)
+        const int s = slot_[i];
+        filled = diskFilled_[i];
+        memcpy( r, slotRow(s), filled * sizeof(V));
+        unlinkDisk(i);
+        slot_[i] = -1;
+        freeSlots_.push_back(s);
+        diskHits_++;
+    }   // end if
+
+    rows_[i] = r;
+    filled_[i] = filled;
+    pushFront(i);
+    return r;
+}   // end row
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::spill( uint i, const V *r, uint filled)
+{
+    if ( disk_ == NULL || filled == 0)
+        return;
+
+    int s;
+    if ( !freeSlots_.empty())
+    {
+        s = freeSlots_.back();
+        freeSlots_.pop_back();
+    }   // end if
+    else
+    {   // Take over the slot of the least recently spilled row
+        const uint lru = dprev_[sz_];
+        unlinkDisk( lru);
+        s = slot_[lru];
+        slot_[lru] = -1;
+    }   // end else
+
+    memcpy( slotRow(s), r, filled * sizeof(V));
+    slot_[i] = s;
+    diskFilled_[i] = filled;
+    pushFrontDisk(i);
+}   // end spill
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::setFilled( uint i, uint len, bool computed)
+{
+    assert( rows_[i] != NULL);
+    if ( computed && len > filled_[i])
+        evals_ += len - filled_[i];
+    filled_[i] = len;
+}   // end setFilled
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::swapIndex( uint i, uint j)
+{
+    if ( i == j)
+        return;
+
+    if ( rows_[i] != NULL) unlink(i);
+    if ( rows_[j] != NULL) unlink(j);
+    std::swap( rows_[i], rows_[j]);
+    std::swap( filled_[i], filled_[j]);
+    if ( rows_[i] != NULL) pushFront(i);
+    if ( rows_[j] != NULL) pushFront(j);
+
+    const uint lo = std::min( i, j);
+    const uint hi = std::max( i, j);
+    for ( uint h = next_[sz_]; h != sz_; h = next_[h])
+    {
+        if ( filled_[h] > hi)
+            std::swap( rows_[h][i], rows_[h][j]);
+        else if ( filled_[h] > lo)
+            filled_[h] = lo;
+    }   // end for
+
+    if ( disk_ == NULL)
+        return;
+
+    if ( slot_[i] >= 0) unlinkDisk(i);
+    if ( slot_[j] >= 0) unlinkDisk(j);
+    std::swap( slot_[i], slot_[j]);
+    std::swap( diskFilled_[i], diskFilled_[j]);
+    if ( slot_[i] >= 0) pushFrontDisk(i);
+    if ( slot_[j] >= 0) pushFrontDisk(j);
+
+    // Spilled rows are cut back to their entries before lo rather than having entries
+    // swapped so that no pages of the scratch file are touched until a row is read back.
+    for ( uint h = dnext_[sz_]; h != sz_; h = dnext_[h])
+        if ( diskFilled_[h] > lo)
+            diskFilled_[h] = lo;
+}   // end swapIndex
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::unlink( uint i)
+{
+    next_[prev_[i]] = next_[i];
+    prev_[next_[i]] = prev_[i];
+}   // end unlink
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::pushFront( uint i)
+{
+    next_[i] = next_[sz_];
+    prev_[i] = sz_;
+    prev_[next_[sz_]] = i;
+    next_[sz_] = i;
+}   // end pushFront
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::unlinkDisk( uint i)
+{
+    dnext_[dprev_[i]] = dnext_[i];
+    dprev_[dnext_[i]] = dprev_[i];
+}   // end unlinkDisk
+
+
+template <typename T, typename V>
+void KernelCache<T,V>::pushFrontDisk( uint i)
+{
+    dnext_[i] = dnext_[sz_];
+    dprev_[i] = sz_;
+    dprev_[dnext_[sz_]] = i;
+    dnext_[sz_] = i;
+}   // end pushFrontDisk
+
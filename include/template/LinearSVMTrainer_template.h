@@ -0,0 +1,249 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+template <typename T>
+const double LinearSVMTrainer<T>::BIAS = 1;
+
+
+template <typename T>
+LinearSVMTrainer<T>::LinearSVMTrainer( const SVMParams &svmp, uint maxIts)
+    : COST(svmp.cost()), EPS(svmp.eps()), MAXITS(maxIts), enableErrOut_(false), numIts_(0)
+{
+    assert( svmp.isLinear());
+}   // end ctor
+
+
+template <typename T>
+LinearSVMTrainer<T>::LinearSVMTrainer( double cost, double tolerance, uint maxIts)
+    : COST(cost), EPS(tolerance), MAXITS(maxIts), enableErrOut_(false), numIts_(0)
+{}   // end ctor
+
+
+template <typename T>
+void LinearSVMTrainer<T>::enableErrorOutput( bool enable)
+{
+    enableErrOut_ = enable;
+}   // end enableErrorOutput
+
+
+template <typename T>
+SVMClassifier::Ptr LinearSVMTrainer<T>::train( const vector<T> &pos, const vector<T> &neg)
+{
+    return trainFrom( pos, neg, NULL);
+}   // end train
+
+
+template <typename T>
+SVMClassifier::Ptr LinearSVMTrainer<T>::retrain( const vector<T> &pos, const vector<T> &neg)
+{
+    if ( seeds_.empty())
+        return trainFrom( pos, neg, NULL);
+
+    vector<double> initAlphas( pos.size() + neg.size(), 0);
+    for ( uint i = 0; i < initAlphas.size(); ++i)
+    {
+        const T &x = i < pos.size() ? pos[i] : neg[i - pos.size()];
+        const boost::unordered_map<const void*, double>::const_iterator it = seeds_.find( x.data);
+        if ( it != seeds_.end())
+            initAlphas[i] = it->second;
+    }   // end for
+    return trainFrom( pos, neg, &initAlphas);
+}   // end retrain
+
+
+template <typename T>
+SVMClassifier::Ptr LinearSVMTrainer<T>::trainFrom( const vector<T> &pos, const vector<T> &neg, const vector<double> *initAlphas)
+{
+    using std::cerr;
+    using std::endl;
+
+    if ( pos.empty() || neg.empty())
+    {
+        SVMClassifier::Ptr null;
+        return null;
+    }   // end if
+
+    struct timeval startTime;
+    gettimeofday( &startTime, NULL);
+
+    const uint negZero = pos.size();
+    const uint n = pos.size() + neg.size();
+    const cv::Size xsize = pos[0].size();
+    const int dims = pos[0].total();
+
+    // Pack the examples and set the diagonal of the (bias augmented) Gram matrix
+    xmat.create( n, dims);
+    vector<double> qd( n);
+    for ( uint i = 0; i < n; ++i)
+    {
+        const T &x = i < negZero ? pos[i] : neg[i - negZero];
+        if ( (int)x.total() != dims)
+        {
+            cerr << "Training example " << i << " has " << x.total() << " elements but expected " << dims << endl;
+            assert(false);
+        }   // end if
+        float *row = xmat.row(i);
+        for ( int r = 0; r < x.rows; ++r)   // Copy row by row in case x isn't continuous
+            memcpy( &row[r*x.cols], x.template ptr<float>(r), x.cols * sizeof(float));
+        qd[i] = dotProduct( row, row, dims) + BIAS*BIAS;
+    }   // end for
+
+    // Set the starting multipliers (only box constrained since the bias is a weight) and the weights
+    alphas.assign( n, 0);
+    w.assign( dims+1, 0);
+    for ( uint i = 0; initAlphas != NULL && i < n; ++i)
+    {
+        const double a = std::min( COST, std::max( 0.0, (*initAlphas)[i]));
+        if ( a <= 0)
+            continue;
+        alphas[i] = a;
+        const double ya = i < negZero ? a : -a;
+        addScaled( &w[0], ya, xmat.row(i), dims);
+        w[dims] += ya * BIAS;
+    }   // end for
+
+    vector<uint> index( n);
+    for ( uint i = 0; i < n; ++i)
+        index[i] = i;
+    rlib::Random rnd( (int)n);
+
+    // Bounds on the projected gradient from the last pass for shrinking
+    double pgMaxOld = INFINITY;
+    double pgMinOld = -INFINITY;
+    uint activeSize = n;
+
+    if ( enableErrOut_)
+    {
+        cerr << "  PG Max  |  PG Min  | Active" << endl;
+        cerr << "===============================" << endl;
+        cerr << std::setprecision(4) << std::fixed;
+    }   // end if - ERROR OUTPUT
+
+    bool converged = false;
+    numIts_ = 0;
+    while ( !converged && numIts_ < MAXITS)
+    {
+        numIts_++;
+        double pgMax = -INFINITY;
+        double pgMin = INFINITY;
+
+        for ( uint s = 0; s < activeSize; ++s)   // Random order over the active examples
+            std::swap( index[s], index[s + rnd.getRandomInt() % (activeSize - s)]);
+
+        for ( uint s = 0; s < activeSize; ++s)
+        {
+            const uint i = index[s];
+            const float *xi = xmat.row(i);
+            const double yi = i < negZero ? 1 : -1;
+            const double g = yi * (dotProduct( &w[0], xi, dims) + w[dims]*BIAS) - 1;
+
+            double pg = 0;  // Projected gradient
+            if ( alphas[i] == 0)
+            {
+                if ( g > pgMaxOld)  // At the lower bound and will stay there so shrink
+                {
+                    activeSize--;
+                    std::swap( index[s], index[activeSize]);
+                    s--;
+                    continue;
+                }   // end if
+                if ( g < 0)
+                    pg = g;
+            }   // end if
+            else if ( alphas[i] == COST)
+            {
+                if ( g < pgMinOld)  // At the upper bound and will stay there so shrink
+                {
+                    activeSize--;
+                    std::swap( index[s], index[activeSize]);
+                    s--;
+                    continue;
+                }   // end if
+                if ( g > 0)
+                    pg = g;
+            }   // end else if
+            else
+                pg = g;
+
+            pgMax = std::max( pgMax, pg);
+            pgMin = std::min( pgMin, pg);
+
+            if ( fabs(pg) > 1e-12)
+            {
+                const double oa = alphas[i];
+                alphas[i] = std::min( std::max( oa - g/qd[i], 0.0), COST);
+                const double d = (alphas[i] - oa) * yi;
+                addScaled( &w[0], d, xi, dims);
+                w[dims] += d * BIAS;
+            }   // end if
+        }   // end for
+
+        if ( enableErrOut_ && numIts_ % 10 == 0)
+        {
+            cerr << std::right << std::setw(9) << pgMax << " | " << std::setw(8) << pgMin
+                 << " | " << activeSize << endl;
+        }   // end if - ERROR OUTPUT
+
+        if ( pgMax - pgMin <= EPS)
+        {
+            converged = activeSize == n;    // Converged over all the examples
+            if ( converged)
+                break;
+            // Check convergence over all the examples with no shrinking on the next pass
+            activeSize = n;
+            pgMaxOld = INFINITY;
+            pgMinOld = -INFINITY;
+            continue;
+        }   // end if
+
+        pgMaxOld = pgMax > 0 ? pgMax : INFINITY;
+        pgMinOld = pgMin < 0 ? pgMin : -INFINITY;
+    }   // end while
+
+    // Keep the solution to warm start any later call to retrain() and count the support vectors
+    seeds_.clear();
+    uint numSVs = 0;
+    for ( uint i = 0; i < n; ++i)
+    {
+        if ( alphas[i] <= 0)
+            continue;
+        numSVs++;
+        const T &x = i < negZero ? pos[i] : neg[i - negZero];
+        seeds_[x.data] = alphas[i];
+    }   // end for
+
+    if ( enableErrOut_)
+    {
+        cerr << "========== " << (converged ? "CONVERGED" : "MAX ITERATIONS") << " ==========" << endl;
+        struct timeval endTime;
+        gettimeofday( &endTime, NULL);
+        uint msecs = (endTime.tv_sec - startTime.tv_sec) * 1000;
+        msecs += (int)round((double)(endTime.tv_usec - startTime.tv_usec) * 0.001);
+        cerr << " " << numIts_ << " iterations (" << msecs << " msecs) " << numSVs << " support vectors" << endl;
+    }   // end if - ERROR OUTPUT
+
+    // The classifier gives z.dot(w) - b so the threshold is the negated bias term
+    cv::Mat_<float> wimg( xsize.height, xsize.width);
+    float *wp = wimg.ptr<float>(0);
+    for ( int k = 0; k < dims; ++k)
+        wp[k] = float(w[k]);
+
+    SVMParams svmp( COST, EPS);
+    SVMClassifier::Ptr svmc( new SVMClassifier( svmp, wimg, -w[dims]*BIAS, numSVs, negZero, n - negZero));
+    svmc->setConverged( converged);
+    return svmc;
+}   // end trainFrom
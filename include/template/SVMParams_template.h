@@ -17,7 +17,7 @@
 
 template <typename T>
 SVMParams::SVMParams( double cost, double eps, const boost::shared_ptr<KernelFunc<T> > k)
-    : cost_(cost), eps_(eps), kernel_(LinearKernel<T>::Type), gamma_(1), coef0_(0), degree_(1)
+    : cost_(cost), eps_(eps), kernel_(LinearKernel<T>::Type), gamma_(1), coef0_(0), degree_(1), cacheSize_(0)
 {
     setKernelParams(k);
 }   // end ctor
@@ -26,23 +26,20 @@ using std::endl;
 #include <sstream>
 using std::ostringstream;
 #include <iomanip>
-#include <sys/time.h>
 
 
-template <typename T>
-const double SVMTrainer<T>::TAU = 1e-12;
+template <typename T, typename V>
+const double SVMTrainer<T,V>::TAU = 1e-12;
 
 
-template <typename T>
-struct SVMTrainer<T>::Alpha
+template <typename T, typename V>
+struct SVMTrainer<T,V>::Alpha
 {
     uint idx;
     double alpha;
 
-    Alpha( uint i, SVMTrainer<T> *s) : idx(0), alpha(0), svm(s)
-    {
-        update(i);
-    }   // end ctor
+    Alpha( uint i, SVMTrainer<T,V> *s) : idx(i), alpha(s->alphas[i]), svm(s)
+    {}   // end ctor
 
     void update( uint i)
     {
@@ -52,147 +49,566 @@ struct SVMTrainer<T>::Alpha
     }   // end reset
 
 private:
-    SVMTrainer<T> *svm;
+    SVMTrainer<T,V> *svm;
 };  // end struct Alpha
 
 
-template <typename T>
-class SVMTrainer<T>::ThreadFn
+template <typename T, typename V>
+const uint SVMTrainer<T,V>::MINSEGSIZE = 512;
+
+template <typename T, typename V>
+const uint SVMTrainer<T,V>::SHRINKPERIOD = 1000;
+
+template <typename T, typename V>
+const uint SVMTrainer<T,V>::TIMECHECKPERIOD = 64;
+
+template <typename T, typename V>
+const char SVMTrainer<T,V>::CKPTMAGIC[8] = {'R','L','S','M','O','C','K','2'};
+
+
+template <typename T, typename V>
+struct SVMTrainer<T,V>::Extrema
+{
+    double minf;    // Min functional prediction over the high index set
+    uint nextHigh;
+    double maxf;    // Max functional prediction over the low index set
+    uint nextLow;
+    char pad[64 - 2*sizeof(double) - 2*sizeof(uint)];   // One cache line per worker
+};  // end struct Extrema
+
+
+template <typename T, typename V>
+class SVMTrainer<T,V>::ThreadFn
 {
 public:
-    ThreadFn( double aH, double aL, uint I, uint J, uint K, uint sgSz,
-            double &mnf, uint &nxtHigh, double &mxf, uint &nxtLow, boost::mutex &m, SVMTrainer<T> *s)
-        : ah(aH), al(aL), i(I), j(J), k(K), segSz(sgSz),
-          minf(mnf), nextHigh( nxtHigh), maxf(mxf), nextLow( nxtLow), mtx( m), svm(s)
+    ThreadFn( double aH, double aL, uint I, uint J, V *rI, uint fI, V *rJ, uint fJ,
+              const V *sI, const V *sJ, uint nsegs, SVMTrainer<T,V> *s)
+        : ah(aH), al(aL), i(I), j(J), ri(rI), rj(rJ), filledi(fI), filledj(fJ), si(sI), sj(sJ), numSegs(nsegs), svm(s)
     {}   // end ctor
 
-    void operator()()
+    // Update the predictions over segment t and write this segment's extrema to svm->extrema[t].
+    void operator()( uint t) const
     {
-        const T &xi = svm->xs[i];
-        const T &xj = svm->xs[j];
-        const double aHigh = ah;
-        const double aLow = al;
+        typename SVMTrainer<T,V>::Extrema &ext = svm->extrema[t];
+        ext.minf = INFINITY;
+        ext.nextHigh = i;
+        ext.maxf = -INFINITY;
+        ext.nextLow = j;
+        if ( t >= numSegs)
+            return;
+
+        const vector<const float*> &xs = svm->xs;
+        const int dims = svm->dims;
+        const uint fnsSz = svm->activeSize;   // Only active examples are updated
+        const uint segSz = fnsSz / numSegs;
+        const uint rem = fnsSz % numSegs;
+        const uint k0 = t * segSz + std::min( t, rem);
+        const uint k1 = k0 + segSz + (t < rem ? 1 : 0);
+        const KernelFunc<T> &kernel = *svm->kernel;
+        const double *sqn = &svm->sqnorms[0];
+
+        // No mutex needed for the array or the kernel rows since different
+        // workers work over different sections. Only entries of the cached
+        // rows from filledi and filledj onwards need calculating. Entries
+        // past both are filled together so each example is read only once.
+        // With a shared cache the entries are gathered from the shared rows
+        // and rows of a whole kernel matrix are read in place (by gidx).
+        if ( svm->gram_)
+        {
+            updateAndSearch( &svm->fns[0], si, sj, &svm->gidx[0], ah, al, &svm->status[0], IN_HIGH, IN_LOW,
+                             k0, k1, ext.minf, ext.nextHigh, ext.maxf, ext.nextLow);
+            return;
+        }   // end if
 
-        const uint nxtSegIdx = k + segSz;
-        const vector<T> &xs = svm->xs;
-        KernelCache<T> *kernelCache = svm->kernelCache;
-        vector<double> &fns = svm->fns;
+        if ( svm->shared_)
+        {
+            const uint *gidx = &svm->gidx[0];
+            for ( uint k = std::max( k0, filledi); k < k1; ++k)
+                ri[k] = si[gidx[k]];
+            for ( uint k = std::max( k0, filledj); k < k1; ++k)
+                rj[k] = sj[gidx[k]];
+        }   // end if
+        else if ( svm->sparse_)
+        {
+            const SparseRow *sxs = &svm->sxs[0];
+            const uint fi = std::max( k0, filledi);
+            const uint fj = std::max( k0, filledj);
+            if ( fi < k1)
+                kernel.sparseRow( sxs[i], sqn[i], &sxs[fi], &sqn[fi], k1 - fi, &ri[fi]);
+            if ( fj < k1)
+                kernel.sparseRow( sxs[j], sqn[j], &sxs[fj], &sqn[fj], k1 - fj, &rj[fj]);
+        }   // end else if
+        else
+        {
+            const bool iFirst = filledi <= filledj;
+            const uint lo = std::max( k0, iFirst ? filledi : filledj);
+            const uint hi = std::min( k1, iFirst ? filledj : filledi);
+            if ( lo < hi)
+            {
+                if ( iFirst)
+                    kernel.normRow( xs[i], sqn[i], &xs[lo], &sqn[lo], hi - lo, dims, &ri[lo]);
+                else
+                    kernel.normRow( xs[j], sqn[j], &xs[lo], &sqn[lo], hi - lo, dims, &rj[lo]);
+            }   // end if
+            const uint both = std::max( k0, std::max( filledi, filledj));
+            if ( both < k1)
+                kernel.normRows( xs[i], sqn[i], xs[j], sqn[j], &xs[both], &sqn[both], k1 - both, dims, &ri[both], &rj[both]);
+        }   // end else
+
+        // Update the predictions and find the new extrema in a single pass
+        updateAndSearch( &svm->fns[0], ri, rj, ah, al, &svm->status[0], IN_HIGH, IN_LOW,
+                         k0, k1, ext.minf, ext.nextHigh, ext.maxf, ext.nextLow);
+    }   // end operator()
+
+private:
+    const double ah, al;
+    const uint i, j;
+    V *ri, *rj;     // Kernel rows of i and j (NULL if gram_)
+    const uint filledi, filledj;
+    const V *si, *sj;   // Shared kernel rows of i and j over the global examples (NULL if not needed)
+    const uint numSegs;
+    SVMTrainer<T,V> *svm;
+};  // end class ThreadFn
 
-        const unordered_set<uint> &highIdxs = svm->highIdxs;
-        const unordered_set<uint> &lowIdxs = svm->lowIdxs;
 
-        double mnf = INFINITY;
-        uint nxtHigh = nextHigh;
-        double mxf = -INFINITY;
-        uint nxtLow = nextLow;
 
-        // No mutex needed for the array since different objects work over different sections
-        while ( k < nxtSegIdx)
+template <typename T, typename V>
+class SVMTrainer<T,V>::ReconstructFn
+{
+public:
+    ReconstructFn( const vector<uint> &svIdxs, uint nsegs, SVMTrainer<T,V> *s)
+        : numSegs(nsegs), svm(s)
+    {
+        BOOST_FOREACH( uint j, svIdxs)
         {
-            if ( xs[k].size() != xi.size())
-            {
-                std::cerr << "xs[" << k << "].size() = " << xs[k].size() << " != xi.size() = " << xi.size() << std::endl;
-                assert(false);
-            }   // end if
+            svxs.push_back( s->xs[j]);
+            if ( s->sparse_)
+                svsxs.push_back( s->sxs[j]);
+            svsqs.push_back( s->sqnorms[j]);
+            coefs.push_back( s->alphas[j] * s->target(j));
+            if ( s->gram_)
+                svgidx.push_back( s->gidx[j]);
+        }   // end foreach
+    }   // end ctor
 
-            if ( xs[k].size() != xj.size())
+    // Recalculate the predictions of the inactive examples in segment t (of all
+    // the examples) and write the segment's extrema to svm->extrema[t].
+    void operator()( uint t) const
+    {
+        typename SVMTrainer<T,V>::Extrema &ext = svm->extrema[t];
+        ext.minf = INFINITY;
+        ext.nextHigh = 0;
+        ext.maxf = -INFINITY;
+        ext.nextLow = 0;
+        if ( t >= numSegs)
+            return;
+
+        const vector<const float*> &xs = svm->xs;
+        const int dims = svm->dims;
+        const uint fnsSz = xs.size();
+        const uint segSz = fnsSz / numSegs;
+        const uint rem = fnsSz % numSegs;
+        const uint k0 = t * segSz + std::min( t, rem);
+        const uint k1 = k0 + segSz + (t < rem ? 1 : 0);
+
+        const KernelFunc<T> &kernel = *svm->kernel;
+        const vector<double> &sqn = svm->sqnorms;
+        const vector<unsigned char> &status = svm->status;
+        vector<double> &fns = svm->fns;
+
+        // Kernel values against all the support vectors are found for two
+        // examples at a time so each support vector is read once per pair.
+        const uint nsvs = svxs.size();
+        vector<V> ki( svm->gram_ ? 0 : nsvs), kj( svm->gram_ ? 0 : nsvs);
+        uint k = std::max( k0, svm->activeSize);
+        for ( ; k < k1; k += 2)
+        {
+            const uint j = std::min( k+1, k1-1);
+            double fi = -svm->target(k);
+            double fj = -svm->target(j);
+            if ( nsvs > 0 && svm->gram_)    // Read from the kernel matrix in place
             {
-                std::cerr << "xs[" << k << "].size() = " << xs[k].size() << " != xj.size() = " << xj.size() << std::endl;
-                assert(false);
+                const typename SharedKernelCache<T,V>::Row gk = svm->shared_->row( svm->gidx[k]);
+                const typename SharedKernelCache<T,V>::Row gj = svm->shared_->row( svm->gidx[j]);
+                const V *rk = &(*gk)[0];
+                const V *rj = &(*gj)[0];
+                for ( uint s = 0; s < nsvs; ++s)
+                {
+                    fi += coefs[s] * rk[svgidx[s]];
+                    fj += coefs[s] * rj[svgidx[s]];
+                }   // end for
             }   // end if
-
-            fns[k] += aHigh*kernelCache->krn( i, xi, k, xs[k]) + aLow*kernelCache->krn( j, xj, k, xs[k]);
-
-            // Test local high/low changes
-            if ( highIdxs.count(k) && fns[k] < mnf)
+            else if ( nsvs > 0)
             {
-                mnf = fns[k];
-                nxtHigh = k;
+                if ( svm->sparse_)
+                {
+                    kernel.sparseRow( svm->sxs[k], sqn[k], &svsxs[0], &svsqs[0], nsvs, &ki[0]);
+                    kernel.sparseRow( svm->sxs[j], sqn[j], &svsxs[0], &svsqs[0], nsvs, &kj[0]);
+                }   // end if
+                else
+                    kernel.normRows( xs[k], sqn[k], xs[j], sqn[j], &svxs[0], &svsqs[0], nsvs, dims, &ki[0], &kj[0]);
+                for ( uint s = 0; s < nsvs; ++s)
+                {
+                    fi += coefs[s] * ki[s];
+                    fj += coefs[s] * kj[s];
+                }   // end for
+            }   // end else if
+            fns[k] = fi;
+            fns[j] = fj;
+        }   // end for
+
+        for ( uint k = k0; k < k1; ++k)
+        {
+            if ( (status[k] & IN_HIGH) && fns[k] < ext.minf)
+            {
+                ext.minf = fns[k];
+                ext.nextHigh = k;
             }   // end if
 
-            if ( lowIdxs.count(k) && fns[k] > mxf)
+            if ( (status[k] & IN_LOW) && fns[k] > ext.maxf)
             {
-                mxf = fns[k];
-                nxtLow = k;
+                ext.maxf = fns[k];
+                ext.nextLow = k;
             }   // end if
+        }   // end for
+    }   // end operator()
+
+private:
+    vector<const float*> svxs;  // Support vectors
+    vector<SparseRow> svsxs;    // Support vectors (if sparse)
+    vector<double> svsqs;       // Squared norms of the support vectors
+    vector<double> coefs;       // Support vector multipliers times targets
+    vector<uint> svgidx;        // Rows of the support vectors in the kernel matrix (if gram_)
+    const uint numSegs;
+    SVMTrainer<T,V> *svm;
+};  // end class ReconstructFn
 
-            k++;
-        }   // end while
 
-        boost::mutex::scoped_lock lock( mtx);
-        if ( mnf < minf)
-        {
-            minf = mnf;
-            nextHigh = nxtHigh;
-        }   // end if
 
-        if ( mxf > maxf)
+template <typename T, typename V>
+class SVMTrainer<T,V>::SelectFn
+{
+public:
+    SelectFn( uint I, V *rI, uint fI, const V *sI, uint nsegs, SVMTrainer<T,V> *s)
+        : i(I), ri(rI), filledi(fI), si(sI), numSegs(nsegs), svm(s)
+    {}   // end ctor
+
+    // Fill segment t of the kernel row of i and write the segment's best second
+    // order partner and its objective decrease to svm->extrema[t] (as nextLow and maxf).
+    void operator()( uint t) const
+    {
+        typename SVMTrainer<T,V>::Extrema &ext = svm->extrema[t];
+        ext.minf = INFINITY;
+        ext.nextHigh = i;
+        ext.maxf = -INFINITY;
+        ext.nextLow = i;
+        if ( t >= numSegs)
+            return;
+
+        const vector<const float*> &xs = svm->xs;
+        const uint fnsSz = svm->activeSize;
+        const uint segSz = fnsSz / numSegs;
+        const uint rem = fnsSz % numSegs;
+        const uint k0 = t * segSz + std::min( t, rem);
+        const uint k1 = k0 + segSz + (t < rem ? 1 : 0);
+
+        // Only entries from filledi onwards need calculating. Rows of a
+        // whole kernel matrix are read in place (by gidx) instead.
+        const uint kf = std::max( k0, filledi);
+        const uint *gidx = NULL;
+        if ( svm->gram_)
+            gidx = &svm->gidx[0];
+        else if ( svm->shared_)
         {
-            maxf = mxf;
-            nextLow = nxtLow;
+            const uint *gidx = &svm->gidx[0];
+            for ( uint k = kf; k < k1; ++k)
+                ri[k] = si[gidx[k]];
         }   // end if
+        else if ( kf < k1)
+        {
+            const double *sqn = &svm->sqnorms[0];
+            if ( svm->sparse_)
+                svm->kernel->sparseRow( svm->sxs[i], sqn[i], &svm->sxs[kf], &sqn[kf], k1 - kf, &ri[kf]);
+            else
+                svm->kernel->normRow( xs[i], sqn[i], &xs[kf], &sqn[kf], k1 - kf, svm->dims, &ri[kf]);
+        }   // end else if
+
+        const double *fns = &svm->fns[0];
+        const double *diag = &svm->diag[0];
+        const unsigned char *status = &svm->status[0];
+        const double fi = fns[i];
+        const double kii = diag[i];
+        for ( uint k = k0; k < k1; ++k)
+        {
+            if ( !(status[k] & IN_LOW) || fns[k] <= fi)
+                continue;
+            const double kik = gidx ? si[gidx[k]] : ri[k];
+            double eta = kii + diag[k] - 2*kik;
+            if ( eta <= TAU)
+                eta = TAU;
+            const double bdiff = fns[k] - fi;
+            const double deltaf = bdiff*bdiff/eta;
+            if ( deltaf > ext.maxf)
+            {
+                ext.maxf = deltaf;
+                ext.nextLow = k;
+            }   // end if
+        }   // end for
     }   // end operator()
 
 private:
-    const double ah, al;
-    const uint i, j;
-    uint k;
-    const uint segSz;
-
-    double &minf;
-    uint &nextHigh;
-    double &maxf;
-    uint &nextLow;
-    boost::mutex &mtx;
-
-    SVMTrainer<T> *svm;
-};  // end class ThreadFn
+    const uint i;
+    V *ri;
+    const uint filledi;
+    const V *si;    // Shared kernel row of i over the global examples (NULL if not needed)
+    const uint numSegs;
+    SVMTrainer<T,V> *svm;
+};  // end class SelectFn
 
 
 
-template <typename T>
-SVMTrainer<T>::SVMTrainer( const SVMParams &svmp, uint mt) throw (InvalidKernelException)
-    : MAXTHREADS(mt), COST(svmp.cost()), EPS(svmp.eps()),
-    kernel( svmp.makeKernel<T>()), kernelCache(NULL)
+template <typename T, typename V>
+SVMTrainer<T,V>::SVMTrainer( const SVMParams &svmp, uint mt) throw (InvalidKernelException)
+    : MAXTHREADS(mt), COST(svmp.cost()), EPS(svmp.eps()), CACHEMB(svmp.cacheSize()),
+    kernel( svmp.makeKernel<T>()), kernelCache(NULL), workers(NULL), enableErrOut_(false), packed_(true), shrinking_(true), secondOrder_(true), numIts_(0), obsPeriod_(100), kernelEvals_(0), gathered_(0), maxIts_(0), maxSecs_(0), converged_(false), ckptPeriod_(10000), precompute_(false), diskMB_(0), gram_(false), sparse_(false), dims(0)
 {
     if ( mt == 0)
         MAXTHREADS = boost::thread::hardware_concurrency();
+    workers = new WorkerPool( MAXTHREADS);
+    MAXTHREADS = workers->size();
+    extrema.resize( MAXTHREADS);
 }   // end ctor
 
 
 
-template <typename T>
-SVMTrainer<T>::SVMTrainer( const typename KernelFunc<T>::Ptr kf, double cost, double tolerance, uint mt)
-    : MAXTHREADS(mt), COST(cost), EPS(tolerance), kernel(kf), kernelCache(NULL)
+template <typename T, typename V>
+SVMTrainer<T,V>::SVMTrainer( const typename KernelFunc<T>::Ptr kf, double cost, double tolerance, uint mt, double cacheMB)
+    : MAXTHREADS(mt), COST(cost), EPS(tolerance), CACHEMB(cacheMB), kernel(kf), kernelCache(NULL), workers(NULL), enableErrOut_(false), packed_(true), shrinking_(true), secondOrder_(true), numIts_(0), obsPeriod_(100), kernelEvals_(0), gathered_(0), maxIts_(0), maxSecs_(0), converged_(false), ckptPeriod_(10000), precompute_(false), diskMB_(0), gram_(false), sparse_(false), dims(0)
 {
     if (mt == 0)
         MAXTHREADS = boost::thread::hardware_concurrency();
+    workers = new WorkerPool( MAXTHREADS);
+    MAXTHREADS = workers->size();
+    extrema.resize( MAXTHREADS);
 }   // end ctor
 
 
-template <typename T>
-SVMTrainer<T>::~SVMTrainer()
+template <typename T, typename V>
+SVMTrainer<T,V>::~SVMTrainer()
 {
     if ( kernelCache != NULL) delete kernelCache;
+    delete workers;
 }   // end dtor
 
 
-template <typename T>
-void SVMTrainer<T>::enableErrorOutput( bool enable)
+template <typename T, typename V>
+void SVMTrainer<T,V>::enableErrorOutput( bool enable)
 {
     enableErrOut_ = enable;
 }   // end enableErrorOutput
 
 
-template <typename T>
-SVMClassifier::Ptr SVMTrainer<T>::train( const vector<T> &pos, const vector<T> &neg)
+template <typename T, typename V>
+void SVMTrainer<T,V>::enablePackedStorage( bool enable)
 {
-    //static const uint SEC_ORD_HEUR_GAP = 1; // Every iteration
-    static const uint SAMPLESIZE = 100;
+    packed_ = enable;
+}   // end enablePackedStorage
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::enableShrinking( bool enable)
+{
+    shrinking_ = enable;
+}   // end enableShrinking
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::enableSecondOrderSelection( bool enable)
+{
+    secondOrder_ = enable;
+}   // end enableSecondOrderSelection
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setObserver( const SVMTrainingObserver::Ptr observer, uint period)
+{
+    observer_ = observer;
+    obsPeriod_ = std::max<uint>( 1, period);
+}   // end setObserver
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setMaxIterations( uint maxIterations)
+{
+    maxIts_ = maxIterations;
+}   // end setMaxIterations
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setTimeLimit( double maxSecs)
+{
+    maxSecs_ = std::max( 0.0, maxSecs);
+}   // end setTimeLimit
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setCancelToken( const CancelToken::Ptr token)
+{
+    cancel_ = token;
+}   // end setCancelToken
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setCheckpoint( const std::string &fname, uint period)
+{
+    ckptFile_ = fname;
+    ckptPeriod_ = std::max<uint>( 1, period);
+}   // end setCheckpoint
+
 
+template <typename T, typename V>
+void SVMTrainer<T,V>::setSharedCache( const typename SharedKernelCache<T,V>::Ptr cache, const vector<uint> &globalIdxs)
+{
+    sharedCache_ = cache;
+    sharedIdxs_ = globalIdxs;
+    if ( !sharedCache_)
+        sharedIdxs_.clear();
+}   // end setSharedCache
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setExampleWeights( const vector<double> &posWeights, const vector<double> &negWeights)
+{
+    weights_ = posWeights;
+    weights_.insert( weights_.end(), negWeights.begin(), negWeights.end());
+}   // end setExampleWeights
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setDiskCache( const std::string &dir, double diskMB)
+{
+    diskDir_ = dir;
+    diskMB_ = diskMB;
+}   // end setDiskCache
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::enablePrecomputedKernel( bool enable)
+{
+    precompute_ = enable;
+}   // end enablePrecomputedKernel
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setGramMatrix( const cv::Mat_<V> &gram)
+{
+    vector<uint> idxs( gram.rows);
+    for ( uint i = 0; i < idxs.size(); ++i)
+        idxs[i] = i;
+    setSharedCache( typename SharedKernelCache<T,V>::Ptr( new SharedKernelCache<T,V>( kernel, gram)), idxs);
+}   // end setGramMatrix
+
+
+template <typename T, typename V>
+double SVMTrainer<T,V>::elapsedSecs() const
+{
+    struct timeval now;
+    gettimeofday( &now, NULL);
+    return (now.tv_sec - startTime_.tv_sec) + (now.tv_usec - startTime_.tv_usec) * 1e-6;
+}   // end elapsedSecs
+
+
+template <typename T, typename V>
+bool SVMTrainer<T,V>::stopEarly() const
+{
+    if ( maxIts_ > 0 && numIts_ >= maxIts_)
+        return true;
+    if ( cancel_ && cancel_->isCancelled())
+        return true;
+    // Reading the clock every iteration costs more than the check is worth
+    return maxSecs_ > 0 && numIts_ % TIMECHECKPERIOD == 0 && elapsedSecs() >= maxSecs_;
+}   // end stopEarly
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::reportProgress( double bHigh, double bLow, bool converged) const
+{
+    SVMTrainingProgress p;
+    p.iteration = numIts_;
+    p.gap = bLow - bHigh;
+    p.activeSize = activeSize;
+    p.numExamples = xs.size();
+    p.cacheHitRate = kernelCache ? kernelCache->hitRate() : 1;   // Every value is read from the kernel matrix if gram_
+    p.kernelEvals = (kernelCache ? kernelCache->evaluations() : 0) + kernelEvals_;
+    p.gatheredValues = gathered_;
+    p.msecs = elapsedSecs() * 1000;
+    p.converged = converged;
+    observer_->progress( p);
+}   // end reportProgress
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::train( const vector<T> &pos, const vector<T> &neg)
+{
+    return trainFrom( pos, neg, NULL);
+}   // end train
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::train( const vector<T> &pos, const vector<T> &neg,
+                                         const vector<double> &posAlphas, const vector<double> &negAlphas)
+{
+    if ( posAlphas.size() != pos.size() || negAlphas.size() != neg.size())
+    {
+        std::cerr << "Warm start multipliers given for " << posAlphas.size() << " positive and " << negAlphas.size()
+                  << " negative examples but expected " << pos.size() << " and " << neg.size() << std::endl;
+        assert(false);
+    }   // end if
+
+    vector<double> initAlphas( posAlphas);
+    initAlphas.insert( initAlphas.end(), negAlphas.begin(), negAlphas.end());
+    return trainFrom( pos, neg, &initAlphas);
+}   // end train
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::retrain( const vector<T> &pos, const vector<T> &neg)
+{
+    if ( seeds_.empty())
+        return trainFrom( pos, neg, NULL);
+
+    vector<double> initAlphas( pos.size() + neg.size(), 0);
+    for ( uint i = 0; i < initAlphas.size(); ++i)
+    {
+        const T &x = i < pos.size() ? pos[i] : neg[i - pos.size()];
+        const boost::unordered_map<const void*, double>::const_iterator it = seeds_.find( x.data);
+        if ( it != seeds_.end())
+            initAlphas[i] = it->second;
+    }   // end for
+    return trainFrom( pos, neg, &initAlphas);
+}   // end retrain
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::getAlphas( vector<double> &posAlphas, vector<double> &negAlphas) const
+{
+    posAlphas.resize( negZero);
+    negAlphas.resize( alphas.size() - negZero);
+    for ( uint j = 0; j < alphas.size(); ++j)
+    {
+        if ( order[j] < negZero)
+            posAlphas[order[j]] = alphas[j];
+        else
+            negAlphas[order[j] - negZero] = alphas[j];
+    }   // end for
+}   // end getAlphas
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::trainFrom( const vector<T> &pos, const vector<T> &neg, const vector<double> *initAlphas)
+{
     // For timing training
-    struct timeval startTime;
-    gettimeofday( &startTime, NULL);
+    gettimeofday( &startTime_, NULL);
 
     if ( pos.empty() || neg.empty())
     {
@@ -201,6 +617,8 @@ SVMClassifier::Ptr SVMTrainer<T>::train( const vector<T> &pos, const vector<T> &
     }   // end if
 
     reset( pos, neg);
+    if ( initAlphas != NULL)
+        setInitialAlphas( *initAlphas);
 
     double bHigh = -1;
     double bLow = 1;
@@ -208,6 +626,101 @@ SVMClassifier::Ptr SVMTrainer<T>::train( const vector<T> &pos, const vector<T> &
     Alpha ah( 0, this); // First positive example
     Alpha al( negZero, this);  // First negative example
 
+    if ( initAlphas != NULL)
+    {
+        // Rebuild all the predictions from the support vectors (and select the
+        // first working set pair) in one parallel pass over the examples.
+        activeSize = 0;
+        unshrink( ah, al, bHigh, bLow);
+    }   // end if
+
+    numIts_ = 0;
+    SVMClassifier::Ptr svmc = solve( ah, al, bHigh, bLow);
+    keepSeeds( pos, neg);
+    return svmc;
+}   // end trainFrom
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::train( const SparseMatrix &pos, const SparseMatrix &neg)
+{
+    gettimeofday( &startTime_, NULL);
+
+    if ( pos.rows() == 0 || neg.rows() == 0)
+    {
+        SVMClassifier::Ptr null;
+        return null;
+    }   // end if
+
+    resetSparse( pos, neg);
+    seeds_.clear();
+
+    Alpha ah( 0, this); // First positive example
+    Alpha al( negZero, this);  // First negative example
+    numIts_ = 0;
+    return solve( ah, al, -1, 1);
+}   // end train
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::train( const TrainingView &view)
+{
+    gettimeofday( &startTime_, NULL);
+
+    if ( view.numPos == 0 || view.numNeg == 0)
+    {
+        SVMClassifier::Ptr null;
+        return null;
+    }   // end if
+
+    resetView( view);
+    seeds_.clear();
+
+    Alpha ah( 0, this); // First positive example
+    Alpha al( negZero, this);  // First negative example
+    numIts_ = 0;
+    return solve( ah, al, -1, 1);
+}   // end train
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::resume( const std::string &fname, const vector<T> &pos, const vector<T> &neg)
+{
+    gettimeofday( &startTime_, NULL);
+
+    if ( pos.empty() || neg.empty())
+    {
+        SVMClassifier::Ptr null;
+        return null;
+    }   // end if
+
+    reset( pos, neg);
+    if ( !readCheckpoint( fname))
+    {
+        delete kernelCache;
+        kernelCache = NULL;
+        SVMClassifier::Ptr null;
+        return null;
+    }   // end if
+
+    // Recalculate the predictions of any examples that were shrunk when the
+    // checkpoint was written and select the working set over all the examples.
+    double bHigh = -1;
+    double bLow = 1;
+    Alpha ah( 0, this);
+    Alpha al( negZero, this);
+    unshrink( ah, al, bHigh, bLow);
+    SVMClassifier::Ptr svmc = solve( ah, al, bHigh, bLow);
+    keepSeeds( pos, neg);
+    return svmc;
+}   // end resume
+
+
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::solve( Alpha &ah, Alpha &al, double bHigh, double bLow)
+{
+    static const uint SAMPLESIZE = 100;
+
     uint smpCnt = 0;
     if ( enableErrOut_)
     {
@@ -216,87 +729,280 @@ SVMClassifier::Ptr SVMTrainer<T>::train( const vector<T> &pos, const vector<T> &
         cerr << std::setprecision(4) << std::fixed;
     }   // end if - ERROR OUTPUT
 
-    while ( bLow - bHigh >= EPS)
+    converged_ = false;
+    bool stoppable = false;     // Not until an iteration is made (so there's a support vector)
+    uint shrinkCounter = std::min<uint>( xs.size(), SHRINKPERIOD);
+    while ( true)
     {
-        optimise( ah, al, bHigh - bLow);
+        if ( bLow - bHigh < EPS)
+        {
+            // Converged over the active set so confirm over all the examples
+            if ( activeSize == xs.size())
+            {
+                converged_ = true;
+                break;
+            }   // end if
+            unshrink( ah, al, bHigh, bLow);
+            continue;
+        }   // end if
+
+        if ( stoppable && stopEarly())   // The classifier is made from the multipliers as they are
+        {
+            if ( !ckptFile_.empty())
+                writeCheckpoint();
+            break;
+        }   // end if
+
+        optimise( ah, al, fns[ah.idx] - fns[al.idx]);
+        numIts_++;
+        stoppable = true;
         updateIndexSets( ah.alpha, ah.idx);
         updateIndexSets( al.alpha, al.idx);
 
         // Updates functional predictions, updates bHigh and bLow, and computes
-        // next working set alpha pair (ah and al) using first order heuristic.
+        // next working set alpha pair (ah and al) using first or second order heuristic.
         updatePredictions( ah, al, bHigh, bLow);
 
-        if ( enableErrOut_)
+        if ( shrinking_ && --shrinkCounter == 0)
         {
-            // Select next low index based on second order heuristic. This is more complex
-            // to calculate so is used less frequently than the first order heuristic 
-            // already calculated at only constant cost.
-            //if ( smpCnt % SEC_ORD_HEUR_GAP == 0)
-            //    al.idx = selectSecondOrderPartner( ah.idx);
+            shrinkCounter = std::min<uint>( xs.size(), SHRINKPERIOD);
+            doShrinking( ah, al, bHigh, bLow);
+        }   // end if
+
+        if ( observer_ && numIts_ % obsPeriod_ == 0)
+            reportProgress( bHigh, bLow, false);
+
+        if ( !ckptFile_.empty() && numIts_ % ckptPeriod_ == 0)
+            writeCheckpoint();
 
+        if ( enableErrOut_)
+        {
             if ( smpCnt++ % SAMPLESIZE == 0)
             {
                 char ahc = target(ah.idx) == 1 ? '+' : '-';
                 char alc = target(al.idx) == 1 ? '+' : '-';
                 cerr << std::right << std::setw(8) << bHigh
                      << " | " << std::setw(7) << bLow
-                     << " | " << ah.idx << "," << al.idx << " (" << ahc << alc << ")" << endl;
+                     << " | " << order[ah.idx] << "," << order[al.idx] << " (" << ahc << alc << ")" << endl;
             }   // end if
         }   // end if - ERROR OUTPUT
     }   // end while
 
+    if ( observer_)
+        reportProgress( bHigh, bLow, converged_);
+
     if ( enableErrOut_)
     {
-        cerr << "========== CONVERGED ==========" << endl;
+        cerr << "========== " << (converged_ ? "CONVERGED" : "STOPPED EARLY") << " ==========" << endl;
         cerr << std::setprecision(4) << std::fixed;
         // Calculate time taken to train
         struct timeval endTime;
         gettimeofday( &endTime, NULL);
-        uint msecs = (endTime.tv_sec - startTime.tv_sec) * 1000;
-        msecs += (int)round((double)(endTime.tv_usec - startTime.tv_usec) * 0.001);
-        cerr << " " << smpCnt << " iterations (" << msecs << " msecs)" << endl;
+        uint msecs = (endTime.tv_sec - startTime_.tv_sec) * 1000;
+        msecs += (int)round((double)(endTime.tv_usec - startTime_.tv_usec) * 0.001);
+        cerr << " " << numIts_ << " iterations (" << msecs << " msecs)" << endl;
+        if ( gram_)
+            cerr << " Kernel values read from the " << shared_->size() << " x " << shared_->size() << " kernel matrix" << endl;
+        else
+            cerr << " Kernel cache hit rate " << kernelCache->hitRate()
+                 << " (" << kernelCache->maxRows() << " rows max)" << endl;
+        if ( kernelCache && kernelCache->maxDiskRows() > 0)
+            cerr << " Kernel rows read back from disk " << kernelCache->diskHits()
+                 << " (" << kernelCache->maxDiskRows() << " rows max)" << endl;
     }   // end if - ERROR OUTPUT
 
     delete kernelCache;
     kernelCache = NULL;
-    return createClassifier( (bLow + bHigh)/2);
-}   // end train
+
+    SVMClassifier::Ptr svmc = createClassifier( (bLow + bHigh)/2);
+    svmc->setConverged( converged_);
+    return svmc;
+}   // end solve
 
 
-template <typename T>
-double SVMTrainer<T>::constrainAlpha( double a)
+template <typename T, typename V>
+void SVMTrainer<T,V>::keepSeeds( const vector<T> &pos, const vector<T> &neg)
 {
-    if ( a > COST - TAU) a = COST;
+    seeds_.clear();
+    for ( uint j = 0; j < xs.size(); ++j)
+    {
+        if ( alphas[j] <= 0)
+            continue;
+        const T &x = order[j] < negZero ? pos[order[j]] : neg[order[j] - negZero];
+        seeds_[x.data] = alphas[j];
+    }   // end for
+}   // end keepSeeds
+
+
+// Checkpoint layout (native byte order): the magic, then the uint32 numbers of positive
+// and negative examples, the example length, iteration count, active set size and
+// unshrunk flag, the double cost and tolerance, and then for each example (in the
+// solver's current order) its uint32 original index and double multiplier, prediction
+// and multiplier bound (the bound was added with the RLSMOCK2 magic).
+template <typename T, typename V>
+bool SVMTrainer<T,V>::writeCheckpoint() const
+{
+    const std::string tmpFile = ckptFile_ + ".tmp";
+    std::ofstream ofs( tmpFile.c_str(), std::ios::binary | std::ios::trunc);
+    if ( !ofs.good())
+    {
+        std::cerr << "Unable to open " << tmpFile << " for writing checkpoint" << std::endl;
+        return false;
+    }   // end if
+
+    const uint32_t hdr[6] = { negZero, uint32_t(xs.size() - negZero), uint32_t(dims),
+                              numIts_, activeSize, unshrunk_ ? 1u : 0u};
+    const double prms[2] = { COST, EPS};
+    ofs.write( CKPTMAGIC, sizeof(CKPTMAGIC));
+    ofs.write( (const char*)hdr, sizeof(hdr));
+    ofs.write( (const char*)prms, sizeof(prms));
+    for ( uint j = 0; j < xs.size(); ++j)
+    {
+        const uint32_t oidx = order[j];
+        ofs.write( (const char*)&oidx, sizeof(uint32_t));
+        ofs.write( (const char*)&alphas[j], sizeof(double));
+        ofs.write( (const char*)&fns[j], sizeof(double));
+        ofs.write( (const char*)&cs[j], sizeof(double));
+    }   // end for
+    ofs.close();
+
+    if ( ofs.fail() || rename( tmpFile.c_str(), ckptFile_.c_str()) != 0)
+    {
+        std::cerr << "Failed to write checkpoint to " << ckptFile_ << std::endl;
+        remove( tmpFile.c_str());
+        return false;
+    }   // end if
+    return true;
+}   // end writeCheckpoint
+
+
+template <typename T, typename V>
+bool SVMTrainer<T,V>::readCheckpoint( const std::string &fname)
+{
+    std::ifstream ifs( fname.c_str(), std::ios::binary);
+    char magic[sizeof(CKPTMAGIC)];
+    uint32_t hdr[6];
+    double prms[2];
+    ifs.read( magic, sizeof(magic));
+    ifs.read( (char*)hdr, sizeof(hdr));
+    ifs.read( (char*)prms, sizeof(prms));
+    if ( !ifs.good() || memcmp( magic, CKPTMAGIC, sizeof(CKPTMAGIC)) != 0)
+    {
+        std::cerr << "Unable to read checkpoint from " << fname << std::endl;
+        return false;
+    }   // end if
+
+    const uint n = xs.size();
+    if ( hdr[0] != negZero || hdr[1] != n - negZero || int(hdr[2]) != dims || hdr[4] > n)
+    {
+        std::cerr << "Checkpoint " << fname << " is for " << hdr[0] << " positive and " << hdr[1]
+                  << " negative examples of length " << hdr[2] << " but training on " << negZero
+                  << " positive and " << (n - negZero) << " of length " << dims << std::endl;
+        return false;
+    }   // end if
+
+    if ( prms[0] != COST || prms[1] != EPS)
+    {
+        std::cerr << "Checkpoint " << fname << " was made with cost " << prms[0] << " and tolerance "
+                  << prms[1] << " but this trainer has cost " << COST << " and tolerance " << EPS << std::endl;
+        return false;
+    }   // end if
+
+    vector<uint32_t> ckOrder( n);
+    vector<double> ckAlphas( n), ckFns( n), ckCs( n);
+    vector<bool> seen( n, false);
+    for ( uint j = 0; j < n; ++j)
+    {
+        ifs.read( (char*)&ckOrder[j], sizeof(uint32_t));
+        ifs.read( (char*)&ckAlphas[j], sizeof(double));
+        ifs.read( (char*)&ckFns[j], sizeof(double));
+        ifs.read( (char*)&ckCs[j], sizeof(double));
+        if ( !ifs.good() || ckOrder[j] >= n || seen[ckOrder[j]])
+        {
+            std::cerr << "Checkpoint " << fname << " is truncated or corrupt" << std::endl;
+            return false;
+        }   // end if
+        seen[ckOrder[j]] = true;
+    }   // end for
+
+    // Permute the examples (just reset so in their original order) into the checkpointed order
+    vector<uint> where( n);  // Current position of each original index
+    for ( uint j = 0; j < n; ++j)
+        where[j] = j;
+    for ( uint j = 0; j < n; ++j)
+    {
+        const uint k = where[ckOrder[j]];
+        if ( k == j)
+            continue;
+        swapIndex( j, k);
+        where[order[k]] = k;
+        where[order[j]] = j;
+    }   // end for
+
+    // The multipliers are only feasible (and the predictions right) under the same bounds
+    for ( uint j = 0; j < n; ++j)
+    {
+        if ( ckCs[j] != cs[j])
+        {
+            std::cerr << "Checkpoint " << fname << " was made with bound " << ckCs[j] << " on example "
+                      << order[j] << " but its bound is now " << cs[j] << " (different example weights)" << std::endl;
+            return false;
+        }   // end if
+    }   // end for
+
+    for ( uint j = 0; j < n; ++j)
+    {
+        alphas[j] = ckAlphas[j];
+        fns[j] = ckFns[j];
+        updateIndexSets( alphas[j], j);
+    }   // end for
+
+    numIts_ = hdr[3];
+    activeSize = hdr[4];
+    unshrunk_ = hdr[5] != 0;
+    return true;
+}   // end readCheckpoint
+
+
+template <typename T, typename V>
+double SVMTrainer<T,V>::constrainAlpha( double a, uint idx) const
+{
+    const double c = cs[idx];
+    if ( a > c - TAU) a = c;
     else if ( a < TAU) a = 0;
     return a;
 }   // end constrainAlpha
 
 
-template <typename T>
-void SVMTrainer<T>::optimise( Alpha &high, Alpha &low, double bDiff)
+template <typename T, typename V>
+void SVMTrainer<T,V>::optimise( Alpha &high, Alpha &low, double bDiff)
 {
     const uint i = high.idx;
     const uint j = low.idx;
     const int yi = target(i);
     const int yj = target(j);
-    const T &xi = xs[i];
-    const T &xj = xs[j];
-    const double kii = kernelCache->krn( i, xi, i, xi);
-    const double kjj = kernelCache->krn( j, xj, j, xj);
-    const double kij = kernelCache->krn( i, xi, j, xj);
-    const double eta = kii + kjj - 2*kij;
+    double kij;
+    if ( gram_)
+        kij = (*shared_->row( gidx[i]))[gidx[j]];
+    else if ( sparse_)
+        kij = kernelCache->krn( i, sxs[i], sqnorms[i], j, sxs[j], sqnorms[j]);
+    else
+        kij = kernelCache->krn( i, xs[i], j, xs[j], dims);
+    double eta = diag[i] + diag[j] - 2*kij;
+    if ( eta <= TAU)    // Kernel not positive definite over this pair
+        eta = TAU;
 
     const double oja = alphas[j];
     const double oia = alphas[i];
 
-    low.alpha = constrainAlpha( oja + yj*bDiff/eta);
-    high.alpha = constrainAlpha( oia + yi*yj*(oja - low.alpha));
-    low.alpha = constrainAlpha( oja + yi*yj*(oia - high.alpha));
+    low.alpha = constrainAlpha( oja + yj*bDiff/eta, j);
+    high.alpha = constrainAlpha( oia + yi*yj*(oja - low.alpha), i);
+    low.alpha = constrainAlpha( oja + yi*yj*(oia - high.alpha), j);
 }   // end optimise
 
 
-template <typename T>
-void SVMTrainer<T>::updatePredictions( Alpha &high, Alpha &low, double &bHigh, double &bLow)
+template <typename T, typename V>
+void SVMTrainer<T,V>::updatePredictions( Alpha &high, Alpha &low, double &bHigh, double &bLow)
 {
     const uint i = high.idx;
     const uint j = low.idx;
@@ -304,89 +1010,248 @@ void SVMTrainer<T>::updatePredictions( Alpha &high, Alpha &low, double &bHigh, d
     const double ah = (high.alpha - alphas[i]) * target(i);
     const double al = (low.alpha - alphas[j]) * target(j);
 
-    uint nextHigh = i;
-    uint nextLow = j;
-
-    bHigh = INFINITY;
-    bLow = -INFINITY;
-    boost::mutex mtx;
-
-    const uint fnsSz = fns.size();
-    const uint SEGSIZE = fnsSz / MAXTHREADS;
-    const uint REM = fnsSz % MAXTHREADS;
-    uint segSz = SEGSIZE;
-    uint segOffset = 0;
-    boost::thread_group tGrp;
-    for ( uint t = 0; t < MAXTHREADS; ++t)
-    {
-        segSz = SEGSIZE;
-        if ( t < REM) segSz++;
-        ThreadFn tFnObj( ah, al, i, j, segOffset, segSz, bHigh, nextHigh, bLow, nextLow, mtx, this);
-        segOffset += segSz;
-        boost::thread *tThrd = new boost::thread( tFnObj);
-        tGrp.add_thread( tThrd);
-    }   // end for
-    tGrp.join_all();  // Member threads deleted at end of function
-
-    // Update Alphas and set first order heuristic for next Alpha pair
+    const uint nsegs = numSegments( activeSize);
+
+    // Rows of i and j are filled in by the workers (in parallel) as needed. Without
+    // a kernel cache the rows of the kernel matrix are read in place by the workers.
+    uint filledi = 0, filledj = 0;
+    V *ri = gram_ ? NULL : kernelCache->row( i, filledi);
+    V *rj = gram_ ? NULL : kernelCache->row( j, filledj);
+    typename SharedKernelCache<T,V>::Row si, sj;   // Held until the workers are done
+    if ( shared_ && filledi < activeSize)
+        si = shared_->row( gidx[i]);
+    if ( shared_ && filledj < activeSize)
+        sj = shared_->row( gidx[j]);
+    ThreadFn tFnObj( ah, al, i, j, ri, filledi, rj, filledj,
+                     si ? &(*si)[0] : NULL, sj ? &(*sj)[0] : NULL, nsegs, this);
+    if ( nsegs == 1)
+        tFnObj(0);
+    else
+        workers->run( boost::ref( tFnObj));
+    // Values taken from shared_ aren't counted as evaluations
+    if ( shared_ && filledi < activeSize)
+        gathered_ += activeSize - filledi;
+    if ( shared_ && filledj < activeSize)
+        gathered_ += activeSize - filledj;
+    if ( !gram_ && filledi < activeSize)
+        kernelCache->setFilled( i, activeSize, !shared_);
+    if ( !gram_ && filledj < activeSize)
+        kernelCache->setFilled( j, activeSize, !shared_);
+
+    uint nextHigh, nextLow;
+    reduceExtrema( nsegs, nextHigh, bHigh, nextLow, bLow);
+    if ( secondOrder_ && bLow - bHigh >= EPS)
+        nextLow = selectSecondOrderPartner( nextHigh, nextLow);
+
+    // Update Alphas and set heuristic for next Alpha pair
     high.update( nextHigh);
     low.update( nextLow);
 }   // end updatePredictions
 
 
-template <typename T>   // Second order heuristic by Fan et al. 2005
-uint SVMTrainer<T>::selectSecondOrderPartner( const uint i) const
+template <typename T, typename V>
+uint SVMTrainer<T,V>::numSegments( uint len) const
 {
-    uint bestj = i; // Select j
-    double objMin = -INFINITY;
-    const double kii = kernelCache->krn( i, xs[i], i, xs[i]);
+    // Split over as many workers as have at least MINSEGSIZE examples each.
+    // If there's only enough work for one, run in serial on the calling thread.
+    return std::max<uint>( 1, std::min<uint>( MAXTHREADS, len / MINSEGSIZE));
+}   // end numSegments
 
-    BOOST_FOREACH( uint t, lowIdxs)
-    {
-        if ( fns[i] >= fns[t])
-            continue;
 
-        double eta = kii + kernelCache->krn( t, xs[t], t, xs[t])
-                       - 2*kernelCache->krn( i, xs[i], t, xs[t]);
-        if ( eta <= TAU)
-            eta = TAU;
+template <typename T, typename V>
+void SVMTrainer<T,V>::reduceExtrema( uint nsegs, uint &nextHigh, double &bHigh, uint &nextLow, double &bLow) const
+{
+    // Reduce over the per worker extrema (in worker order so ties go to the lowest index)
+    nextHigh = extrema[0].nextHigh;
+    nextLow = extrema[0].nextLow;
+    bHigh = extrema[0].minf;
+    bLow = extrema[0].maxf;
+    for ( uint t = 1; t < nsegs; ++t)
+    {
+        if ( extrema[t].minf < bHigh)
+        {
+            bHigh = extrema[t].minf;
+            nextHigh = extrema[t].nextHigh;
+        }   // end if
 
-        double bdiff = fns[i] - fns[t];
-        double deltaf = bdiff*bdiff/eta;
-        if ( deltaf >= objMin)
+        if ( extrema[t].maxf > bLow)
         {
-            objMin = deltaf;
-            bestj = t;
+            bLow = extrema[t].maxf;
+            nextLow = extrema[t].nextLow;
         }   // end if
-    }   // end foreach
+    }   // end for
+}   // end reduceExtrema
+
+
+template <typename T, typename V>
+bool SVMTrainer<T,V>::isShrinkable( uint k, double bHigh, double bLow) const
+{
+    if ( status[k] == (IN_HIGH | IN_LOW))   // Free multiplier
+        return false;
+    // At a bound so k can only ever be selected from one of the sets, but
+    // it can't be while its prediction lies on the wrong side of the other.
+    if ( status[k] & IN_HIGH)
+        return fns[k] > bLow;
+    return fns[k] < bHigh;
+}   // end isShrinkable
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::doShrinking( Alpha &high, Alpha &low, double &bHigh, double &bLow)
+{
+    // Once close to convergence, reconstruct the predictions once over all
+    // examples so that the shrinking decisions from here on are accurate.
+    if ( !unshrunk_ && bLow - bHigh <= 10*EPS)
+    {
+        unshrunk_ = true;
+        unshrink( high, low, bHigh, bLow);
+    }   // end if
+
+    for ( uint k = 0; k < activeSize; ++k)
+    {
+        if ( !isShrinkable( k, bHigh, bLow))
+            continue;
+
+        // Find the last active example that isn't shrinkable to swap with k
+        activeSize--;
+        while ( activeSize > k)
+        {
+            if ( !isShrinkable( activeSize, bHigh, bLow))
+            {
+                swapIndex( k, activeSize);
+                // The working set pair are never shrinkable but may be moved
+                if ( high.idx == activeSize) high.idx = k;
+                if ( low.idx == activeSize) low.idx = k;
+                break;
+            }   // end if
+            activeSize--;
+        }   // end while
+    }   // end for
+}   // end doShrinking
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::unshrink( Alpha &high, Alpha &low, double &bHigh, double &bLow)
+{
+    vector<uint> svs;
+    for ( uint j = 0; j < activeSize; ++j)
+        if ( alphas[j] > 0)
+            svs.push_back(j);
+    // Inactive examples are at a bound, but may be non-zero (at their upper bound)
+    for ( uint j = activeSize; j < xs.size(); ++j)
+        if ( alphas[j] > 0)
+            svs.push_back(j);
+
+    if ( gram_)
+        gathered_ += svs.size() * (xs.size() - activeSize);
+    else
+        kernelEvals_ += svs.size() * (xs.size() - activeSize);
+    const uint nsegs = numSegments( xs.size());
+    ReconstructFn rFnObj( svs, nsegs, this);
+    if ( nsegs == 1)
+        rFnObj(0);
+    else
+        workers->run( boost::ref( rFnObj));
+    activeSize = xs.size();
+
+    uint nextHigh, nextLow;
+    reduceExtrema( nsegs, nextHigh, bHigh, nextLow, bLow);
+    if ( secondOrder_ && bLow - bHigh >= EPS)
+        nextLow = selectSecondOrderPartner( nextHigh, nextLow);
+    high.update( nextHigh);
+    low.update( nextLow);
+}   // end unshrink
 
-    return bestj;
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::swapIndex( uint i, uint j)
+{
+    std::swap( xs[i], xs[j]);
+    if ( sparse_)
+        std::swap( sxs[i], sxs[j]);
+    std::swap( alphas[i], alphas[j]);
+    std::swap( fns[i], fns[j]);
+    std::swap( diag[i], diag[j]);
+    std::swap( cs[i], cs[j]);
+    std::swap( sqnorms[i], sqnorms[j]);
+    std::swap( ys[i], ys[j]);
+    std::swap( order[i], order[j]);
+    if ( shared_)
+        std::swap( gidx[i], gidx[j]);
+
+    std::swap( status[i], status[j]);
+
+    if ( kernelCache)
+        kernelCache->swapIndex( i, j);
+}   // end swapIndex
+
+
+template <typename T, typename V>   // Second order heuristic by Fan et al. 2005
+uint SVMTrainer<T,V>::selectSecondOrderPartner( uint i, uint j)
+{
+    const uint nsegs = numSegments( activeSize);
+    uint filledi = 0;
+    V *ri = gram_ ? NULL : kernelCache->row( i, filledi);   // Row of the last pair no longer needed
+    typename SharedKernelCache<T,V>::Row si;
+    if ( shared_ && filledi < activeSize)
+        si = shared_->row( gidx[i]);
+    SelectFn sFnObj( i, ri, filledi, si ? &(*si)[0] : NULL, nsegs, this);
+    if ( nsegs == 1)
+        sFnObj(0);
+    else
+        workers->run( boost::ref( sFnObj));
+    if ( shared_ && filledi < activeSize)
+        gathered_ += activeSize - filledi;
+    if ( !gram_ && filledi < activeSize)
+        kernelCache->setFilled( i, activeSize, !shared_);
+
+    uint dummyHigh, bestj;
+    double dummyf, objMax;
+    reduceExtrema( nsegs, dummyHigh, dummyf, bestj, objMax);
+    return objMax > -INFINITY ? bestj : j;
 }   // end selectSecondOrderPartner
 
 
-template <typename T>
-void SVMTrainer<T>::updateIndexSets( const double a, const uint idx)
+template <typename T, typename V>
+void SVMTrainer<T,V>::updateIndexSets( const double a, const uint idx)
 {
     int y = target( idx);
-    lowIdxs.erase( idx);
-    highIdxs.erase( idx);
-    if (( a < COST && y == 1) || ( a > 0 && y == -1))
-        highIdxs.insert( idx);
-    if (( a > 0 && y == 1) || ( a < COST && y == -1))
-        lowIdxs.insert( idx);
+    unsigned char s = 0;
+    const double c = cs[idx];
+    if (( a < c && y == 1) || ( a > 0 && y == -1))
+        s |= IN_HIGH;
+    if (( a > 0 && y == 1) || ( a < c && y == -1))
+        s |= IN_LOW;
+    status[idx] = s;
 }   // end updateIndexSets
 
 
-template <typename T>
-SVMClassifier::Ptr SVMTrainer<T>::createClassifier( double threshold) const
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::createClassifier( double threshold) const
 {
-    vector<double> *svAlphas = new vector<double>();
-    vector<T> *svExamples = new vector<T>();
+    // Examples may have been reordered by shrinking so add the support vectors in their original order
+    vector<uint> idxs( xs.size());
     for ( uint j = 0; j < xs.size(); ++j)
+        idxs[order[j]] = j;
+
+    vector<double> *svAlphas = new vector<double>();
+    vector<cv::Mat_<float> > *svExamples = new vector<cv::Mat_<float> >();
+    BOOST_FOREACH( uint j, idxs)
     {
-        if ( alphas[j] <= TAU) continue;
+        if ( !isSupportVector( alphas[j])) continue;
         svAlphas->push_back( alphas[j] * target(j));
-        svExamples->push_back( xs[j]);
+        // Copy out since xs only points into xmat or the caller's examples
+        cv::Mat_<float> x( xsize.height, xsize.width);
+        if ( sparse_)
+        {
+            x = 0.0f;
+            float *xp = x.ptr<float>(0);
+            for ( uint k = 0; k < sxs[j].nnz; ++k)
+                xp[sxs[j].idx[k]] = sxs[j].val[k];
+        }   // end if
+        else
+            memcpy( x.ptr<float>(0), xs[j], dims * sizeof(float));
+        svExamples->push_back( x);
     }   // end foreach
 
     SVMParams svmp( COST, EPS, kernel);
@@ -396,47 +1261,218 @@ SVMClassifier::Ptr SVMTrainer<T>::createClassifier( double threshold) const
 }   // end createClassifier
 
 
-template <typename T>
-void SVMTrainer<T>::reset( const vector<T> &pos, const vector<T> &neg)
+template <typename T, typename V>
+void SVMTrainer<T,V>::reset( const vector<T> &pos, const vector<T> &neg)
 {
     negZero = pos.size();   // Starting index of negative examples
-    alphas.clear();
-    fns.clear();
-    xs.clear();
+    const uint n = pos.size() + neg.size();
+    sparse_ = false;
+    sxs.clear();
+    xs.resize( n);
 
-    uint i = 0;
-    BOOST_FOREACH( const T &x, pos)
-    {
-        xs.push_back( x);
-        alphas.push_back( 0);
-        fns.push_back( -1);
-        highIdxs.insert( i++);
-    }   // end foreach
+    xsize = pos[0].size();
+    dims = pos[0].total();
+    if ( packed_)
+        xmat.create( n, dims);
 
-    BOOST_FOREACH( const T &x, neg)
+    for ( uint i = 0; i < n; ++i)
     {
-        xs.push_back( x);
-        alphas.push_back( 0);
-        fns.push_back( 1);
-        lowIdxs.insert( i++);
-    }   // end foreach
+        const T &x = i < negZero ? pos[i] : neg[i - negZero];
+        if ( (int)x.total() != dims)
+        {
+            std::cerr << "Training example " << i << " has " << x.total() << " elements but expected " << dims << std::endl;
+            assert(false);
+        }   // end if
 
-    kernelCache = new KernelCache<T>( kernel, xs.size());
+        if ( packed_)
+        {
+            float *row = xmat.row(i);
+            for ( int r = 0; r < x.rows; ++r)   // Copy row by row in case x isn't continuous
+                memcpy( &row[r*x.cols], x.template ptr<float>(r), x.cols * sizeof(float));
+            xs[i] = row;
+        }   // end if
+        else
+        {
+            assert( x.isContinuous());
+            xs[i] = x.template ptr<float>(0);
+        }   // end else
+    }   // end for
+
+    initState();
 }   // end reset
 
 
-template <typename T>
-int SVMTrainer<T>::target( uint idx) const
+template <typename T, typename V>
+void SVMTrainer<T,V>::resetSparse( const SparseMatrix &pos, const SparseMatrix &neg)
+{
+    if ( pos.cols() != neg.cols())
+    {
+        std::cerr << "Positive examples have " << pos.cols() << " columns but negative examples have " << neg.cols() << std::endl;
+        assert(false);
+    }   // end if
+
+    negZero = pos.rows();   // Starting index of negative examples
+    const uint n = pos.rows() + neg.rows();
+    sparse_ = true;
+    xs.assign( n, (const float*)NULL);
+    sxs.resize( n);
+    xsize = cv::Size( pos.cols(), 1);
+    dims = pos.cols();
+    for ( uint i = 0; i < n; ++i)
+        sxs[i] = i < negZero ? pos.row(i) : neg.row(i - negZero);
+
+    initState();
+}   // end resetSparse
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::resetView( const TrainingView &view)
+{
+    negZero = view.numPos;  // Starting index of negative examples
+    const uint n = view.numPos + view.numNeg;
+    sparse_ = false;
+    sxs.clear();
+    xs.resize( n);
+    xsize = cv::Size( view.dims, 1);
+    dims = view.dims;
+    for ( uint i = 0; i < n; ++i)
+        xs[i] = view.example(i);
+
+    initState();
+}   // end resetView
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::initState()
 {
-    return idx < negZero ? 1 : -1;
+    const uint n = xs.size();
+    activeSize = n;
+    unshrunk_ = false;
+    alphas.assign( n, 0);
+    fns.resize( n);
+    ys.resize( n);
+    order.resize( n);
+    status.resize( n);
+    for ( uint i = 0; i < n; ++i)
+    {
+        order[i] = i;
+        ys[i] = i < negZero ? 1 : -1;
+        fns[i] = -ys[i];
+        status[i] = i < negZero ? IN_HIGH : IN_LOW;
+    }   // end for
+
+    cs.assign( n, COST);
+    if ( !weights_.empty())
+    {
+        if ( weights_.size() != n)
+        {
+            std::cerr << "Example weights given for " << weights_.size()
+                      << " examples but training on " << n << std::endl;
+            assert(false);
+        }   // end if
+        for ( uint i = 0; i < n; ++i)
+            cs[i] = COST * weights_[i];
+    }   // end if
+
+    kernelEvals_ = n;   // The diagonal
+    gathered_ = 0;
+    diag.resize( n);
+    sqnorms.resize( n);
+    for ( uint i = 0; i < n; ++i)
+    {
+        if ( sparse_)
+        {
+            sqnorms[i] = sparseSqNorm( sxs[i]);
+            kernel->sparseRow( sxs[i], sqnorms[i], &sxs[i], &sqnorms[i], 1, &diag[i]);
+        }   // end if
+        else
+        {
+            diag[i] = (*kernel)( xs[i], xs[i], dims);
+            sqnorms[i] = dotProduct( xs[i], xs[i], dims);
+        }   // end else
+    }   // end for
+
+    gidx.clear();
+    shared_ = sharedCache_;
+    if ( shared_)
+    {
+        if ( sharedIdxs_.size() != n)
+        {
+            std::cerr << "Shared kernel cache indices given for " << sharedIdxs_.size()
+                      << " examples but training on " << n << std::endl;
+            assert(false);
+        }   // end if
+        gidx = sharedIdxs_;
+        if ( shared_->isPrecomputed())    // Take the diagonal from the given matrix
+        {
+            for ( uint i = 0; i < n; ++i)
+                diag[i] = (*shared_->row( gidx[i]))[gidx[i]];
+        }   // end if
+    }   // end if
+    else if ( precompute_ && !sparse_)
+    {
+        shared_ = SharedKernelCache<T,V>::precompute( kernel, xs, dims, *workers);
+        gidx.resize( n);
+        for ( uint i = 0; i < n; ++i)
+            gidx[i] = i;
+        kernelEvals_ += size_t(n) * (n-1) / 2;
+    }   // end else if
+
+    // With the whole kernel matrix held, rows are gathered from it rather than cached a second time
+    gram_ = shared_ && shared_->isPrecomputed();
+    if ( gram_)
+        return;
+
+    kernelCache = new KernelCache<T,V>( kernel, n, CACHEMB);
+    if ( !diskDir_.empty() && diskMB_ > 0)
+        kernelCache->enableDiskTier( diskDir_, diskMB_);
+}   // end initState
+
+
+template <typename T, typename V>
+void SVMTrainer<T,V>::setInitialAlphas( const vector<double> &initAlphas)
+{
+    // Clamp to the box constraints
+    double psum = 0;
+    double nsum = 0;
+    for ( uint i = 0; i < alphas.size(); ++i)
+    {
+        alphas[i] = constrainAlpha( std::min( cs[i], std::max( 0.0, initAlphas[i])), i);
+        if ( i < negZero)
+            psum += alphas[i];
+        else
+            nsum += alphas[i];
+    }   // end for
+
+    // Satisfy the equality constraint (sum of y_i*alpha_i is zero) by
+    // scaling down the multipliers of the class with the larger sum.
+    const uint s0 = psum > nsum ? 0 : negZero;
+    const uint s1 = psum > nsum ? negZero : alphas.size();
+    const double scale = psum > nsum ? nsum / psum : (nsum > 0 ? psum / nsum : 1);
+    for ( uint i = s0; i < s1; ++i)
+        alphas[i] = constrainAlpha( alphas[i] * scale, i);
+
+    for ( uint i = 0; i < alphas.size(); ++i)
+        updateIndexSets( alphas[i], i);
+}   // end setInitialAlphas
+
+
+template <typename T, typename V>
+int SVMTrainer<T,V>::target( uint idx) const
+{
+    return ys[idx];
 }   // end target
 
 
 // static
-template <typename T>
-SVMClassifier::Ptr SVMTrainer<T>::train( const vector<T>& pos, const vector<T>& neg, const SVMParams& svmp)
+template <typename T, typename V>
+SVMClassifier::Ptr SVMTrainer<T,V>::train( const vector<T>& pos, const vector<T>& neg, const SVMParams& svmp,
+                                           bool useLinearSolver)
 {
+    if ( useLinearSolver && svmp.isLinear())
+        return LinearSVMTrainer<T>( svmp).train( pos, neg);
+
     const int nthreads = boost::thread::hardware_concurrency();
-    SVMTrainer<T> svmt( svmp, nthreads);
+    SVMTrainer<T,V> svmt( svmp, nthreads);
     return svmt.train( pos, neg);
 }   // end train
@@ -0,0 +1,243 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+template <typename T, typename V>
+SharedKernelCache<T,V>::SharedKernelCache( const typename KernelFunc<T>::Ptr kf,
+                                           const vector<const float*> &xs, int dims, double cacheMB)
+    : kernel(kf), xs_(xs), sqnorms_( xs.size()), dims_(dims), maxRows_( uint(xs.size())),
+      rows_( xs.size()), prev_( xs.size()+NUMSHARDS), next_( xs.size()+NUMSHARDS), precomputed_(false)
+{
+    const uint sz = size();
+    for ( uint i = 0; i < sz; ++i)
+        sqnorms_[i] = dotProduct( xs_[i], xs_[i], dims_);
+
+    if ( cacheMB > 0)
+    {
+        const double rowBytes = double(sz) * sizeof(V);
+        const double nrows = cacheMB * 1024 * 1024 / rowBytes;
+        if ( nrows < maxRows_)
+            maxRows_ = uint(nrows);
+    }   // end if
+    initShards();
+}   // end ctor
+
+
+template <typename T, typename V>
+SharedKernelCache<T,V>::SharedKernelCache( const typename KernelFunc<T>::Ptr kf, const cv::Mat_<V> &gram)
+    : kernel(kf), dims_(0), maxRows_( uint(gram.rows)),
+      rows_( gram.rows), prev_( gram.rows+NUMSHARDS), next_( gram.rows+NUMSHARDS), precomputed_(true)
+{
+    assert( gram.rows == gram.cols);
+    const uint sz = size();
+    for ( uint i = 0; i < sz; ++i)
+    {
+        const V *g = gram.template ptr<V>(i);
+        rows_[i].reset( new vector<V>( g, g + sz));
+    }   // end for
+    initShards();   // Unused since rows are never evicted
+}   // end ctor
+
+
+template <typename T, typename V>
+void SharedKernelCache<T,V>::initShards()
+{
+    const uint sz = size();
+    const bool limited = maxRows_ < sz;
+    const uint perShard = std::max<uint>( 1, maxRows_ / NUMSHARDS);
+    maxRows_ = 0;
+    for ( uint s = 0; s < NUMSHARDS; ++s)
+    {
+        const uint members = std::max<uint>( 1, sz / NUMSHARDS + (s < sz % NUMSHARDS ? 1 : 0));  // Rows that map to shard s
+        shards_[s].maxRows = limited ? std::min( perShard, members) : members;
+        maxRows_ += shards_[s].maxRows;
+        prev_[sz+s] = next_[sz+s] = sz+s;   // Empty list
+    }   // end for
+}   // end initShards
+
+
+template <typename T, typename V>
+class SharedKernelCache<T,V>::GramFn
+{
+public:
+    GramFn( const KernelFunc<T> &k, const vector<const float*> &xs, const vector<double> &sqn,
+            int dims, const vector<V*> &rows, uint nthreads)
+        : kernel(k), xs_(xs), sqn_(sqn), dims_(dims), rows_(rows), nthreads_(nthreads)
+    {
+        const uint nb = (uint(xs.size()) + BLOCK - 1) / BLOCK;
+        for ( uint bi = 0; bi < nb; ++bi)
+            for ( uint bk = bi; bk < nb; ++bk)
+                tiles_.push_back( std::make_pair( bi, bk));
+    }   // end ctor
+
+    // Fill every nthreads-th tile starting from tile t.
+    void operator()( uint t) const
+    {
+        const uint n = uint(xs_.size());
+        V ki[BLOCK], kj[BLOCK];
+        for ( uint p = t; p < tiles_.size(); p += nthreads_)
+        {
+            const uint i0 = tiles_[p].first * BLOCK;
+            const uint i1 = std::min<uint>( i0 + BLOCK, n);
+            const uint k0 = tiles_[p].second * BLOCK;
+            const uint nk = std::min<uint>( k0 + BLOCK, n) - k0;
+            for ( uint i = i0; i < i1; i += 2)
+            {
+                const uint j = std::min( i+1, i1-1);
+                kernel.normRows( xs_[i], sqn_[i], xs_[j], sqn_[j], &xs_[k0], &sqn_[k0], nk, dims_, ki, kj);
+                for ( uint k = 0; k < nk; ++k)
+                {
+                    rows_[i][k0+k] = rows_[k0+k][i] = ki[k];
+                    rows_[j][k0+k] = rows_[k0+k][j] = kj[k];
+                }   // end for
+            }   // end for
+        }   // end for
+    }   // end operator()
+
+private:
+    const KernelFunc<T> &kernel;
+    const vector<const float*> &xs_;
+    const vector<double> &sqn_;
+    const int dims_;
+    const vector<V*> &rows_;
+    const uint nthreads_;
+    vector<std::pair<uint,uint> > tiles_;  // Block row and column of each tile (on or above the diagonal)
+};  // end class
+
+
+// static
+template <typename T, typename V>
+typename SharedKernelCache<T,V>::Ptr SharedKernelCache<T,V>::precompute( const typename KernelFunc<T>::Ptr kf,
+                                                   const vector<const float*> &xs, int dims, WorkerPool &workers)
+{
+    Ptr cache( new SharedKernelCache<T,V>( kf, xs, dims, 0));
+    const uint sz = cache->size();
+    vector<V*> rows( sz);
+    for ( uint i = 0; i < sz; ++i)
+    {
+        vector<V> *r = new vector<V>( sz);
+        cache->rows_[i].reset( r);
+        rows[i] = &(*r)[0];
+    }   // end for
+
+    const GramFn gfn( *kf, cache->xs_, cache->sqnorms_, dims, rows, workers.size());
+    workers.run( boost::ref( gfn));
+
+    cache->precomputed_ = true;
+    return cache;
+}   // end precompute
+
+
+template <typename T, typename V>
+typename SharedKernelCache<T,V>::Row SharedKernelCache<T,V>::row( uint i)
+{
+    if ( precomputed_)  // Rows are never evicted so no locking needed
+        return rows_[i];
+
+    Shard &shard = shards_[i % NUMSHARDS];
+    {
+        boost::mutex::scoped_lock lock( shard.mutex);
+        if ( rows_[i])
+        {
+            shard.hits++;
+            unlink(i);
+            pushFront(i);
+            return rows_[i];
+        }   // end if
+        shard.misses++;
+    }   // end lock
+
+    // Calculate outside of the lock so other threads can read held rows meanwhile
+    const uint sz = size();
+    vector<V> *r = new vector<V>( sz);
+    kernel->normRow( xs_[i], sqnorms_[i], &xs_[0], &sqnorms_[0], sz, dims_, &(*r)[0]);
+    Row nrow( r);
+
+    boost::mutex::scoped_lock lock( shard.mutex);
+    if ( rows_[i]) // Another thread calculated the same row in the meantime
+    {
+        unlink(i);
+        pushFront(i);
+        return rows_[i];
+    }   // end if
+
+    if ( shard.numRows < shard.maxRows)
+        shard.numRows++;
+    else
+    {   // Drop the shard's least recently used row (freed once no longer read)
+        const uint lru = prev_[sz + i % NUMSHARDS];
+        unlink( lru);
+        rows_[lru].reset();
+    }   // end else
+
+    rows_[i] = nrow;
+    pushFront(i);
+    return nrow;
+}   // end row
+
+
+template <typename T, typename V>
+size_t SharedKernelCache<T,V>::hits() const
+{
+    size_t n = 0;
+    for ( uint s = 0; s < NUMSHARDS; ++s)
+    {
+        boost::mutex::scoped_lock lock( shards_[s].mutex);
+        n += shards_[s].hits;
+    }   // end for
+    return n;
+}   // end hits
+
+
+template <typename T, typename V>
+size_t SharedKernelCache<T,V>::misses() const
+{
+    size_t n = 0;
+    for ( uint s = 0; s < NUMSHARDS; ++s)
+    {
+        boost::mutex::scoped_lock lock( shards_[s].mutex);
+        n += shards_[s].misses;
+    }   // end for
+    return n;
+}   // end misses
+
+
+template <typename T, typename V>
+double SharedKernelCache<T,V>::hitRate() const
+{
+    const size_t h = hits();
+    const size_t lookups = h + misses();
+    return lookups > 0 ? double(h)/lookups : 0;
+}   // end hitRate
+
+
+template <typename T, typename V>
+void SharedKernelCache<T,V>::unlink( uint i)
+{
+    next_[prev_[i]] = next_[i];
+    prev_[next_[i]] = prev_[i];
+}   // end unlink
+
+
+template <typename T, typename V>
+void SharedKernelCache<T,V>::pushFront( uint i)
+{
+    const uint head = size() + i % NUMSHARDS;
+    next_[i] = next_[head];
+    prev_[i] = head;
+    prev_[next_[head]] = i;
+    next_[head] = i;
+}   // end pushFront
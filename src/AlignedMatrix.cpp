@@ -0,0 +1,65 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "AlignedMatrix.h"
+using RLearning::AlignedMatrix;
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+
+AlignedMatrix::AlignedMatrix()
+    : _data(NULL), _rows(0), _cols(0), _stride(0), _capacity(0)
+{}   // end ctor
+
+
+AlignedMatrix::AlignedMatrix( uint rows, uint cols)
+    : _data(NULL), _rows(0), _cols(0), _stride(0), _capacity(0)
+{
+    create( rows, cols);
+}   // end ctor
+
+
+AlignedMatrix::~AlignedMatrix()
+{
+    free( _data);
+}   // end dtor
+
+
+void AlignedMatrix::create( uint rows, uint cols)
+{
+    static const size_t FLOATS_PER_LINE = ALIGNMENT / sizeof(float);
+    _rows = rows;
+    _cols = cols;
+    _stride = ((cols + FLOATS_PER_LINE - 1) / FLOATS_PER_LINE) * FLOATS_PER_LINE;
+
+    const size_t sz = _rows * _stride;
+    if ( sz > _capacity)
+    {
+        free( _data);
+        _data = NULL;
+        _capacity = 0;
+        void *mem = NULL;
+        if ( posix_memalign( &mem, ALIGNMENT, sz * sizeof(float)) != 0)
+            throw std::bad_alloc();
+        _data = (float*)mem;
+        _capacity = sz;
+    }   // end if
+
+    if ( sz > 0)
+        memset( _data, 0, sz * sizeof(float));
+}   // end create
@@ -0,0 +1,249 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "CascadeSVMTrainer.h"
+using RLearning::CascadeSVMTrainer;
+#include "SVMTrainer.h"
+using RLearning::SVMTrainer;
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/bind.hpp>
+
+
+namespace
+{
+
+// Shuffle v in place (Fisher-Yates).
+void shuffle( vector<uint> &v)
+{
+    for ( uint i = uint(v.size()); i > 1; --i)
+        std::swap( v[i-1], v[ std::min<uint>( uint(drand48() * i), i-1)]);
+}   // end shuffle
+
+
+// Append the examples of ids (with their multipliers as) to ids0 (and as0) if not
+// already there. Where an example is in both, the multiplier of ids0 is kept.
+void mergeInto( vector<uint> &ids0, vector<double> &as0,
+                const vector<uint> &ids, const vector<double> &as, vector<int> &where)
+{
+    for ( uint k = 0; k < ids0.size(); ++k)
+        where[ids0[k]] = int(k);
+    for ( uint k = 0; k < ids.size(); ++k)
+    {
+        if ( where[ids[k]] >= 0)
+            continue;
+        where[ids[k]] = int(ids0.size());
+        ids0.push_back( ids[k]);
+        as0.push_back( as[k]);
+    }   // end for
+    for ( uint k = 0; k < ids0.size(); ++k)    // Leave where all -1 again
+        where[ids0[k]] = -1;
+}   // end mergeInto
+
+
+// Return the sorted copy of v.
+vector<uint> sorted( vector<uint> v)
+{
+    std::sort( v.begin(), v.end());
+    return v;
+}   // end sorted
+
+}   // end namespace
+
+
+CascadeSVMTrainer::CascadeSVMTrainer( const SVMParams &svmp, uint numParts, uint nthreads, uint maxPasses)
+    : svmp_(svmp), kernel_( svmp.makeKernel<cv::Mat_<float> >()), maxPasses_( std::max<uint>( maxPasses, 1)),
+      numParts_(1), workers_( new WorkerPool( nthreads)), numPasses_(0), converged_(false),
+      nextSubset_(0), pos_(NULL), neg_(NULL)
+{
+    if ( numParts == 0)
+        numParts = workers_->size();
+    while ( numParts_ < numParts)
+        numParts_ <<= 1;
+}   // end ctor
+
+
+CascadeSVMTrainer::~CascadeSVMTrainer()
+{
+    delete workers_;
+}   // end dtor
+
+
+SVMClassifier::Ptr CascadeSVMTrainer::train( const vector<cv::Mat_<float> > &pos, const vector<cv::Mat_<float> > &neg)
+{
+    numPasses_ = 0;
+    converged_ = false;
+    if ( pos.empty() || neg.empty())
+        return SVMClassifier::Ptr();
+
+    const uint npos = uint(pos.size());
+    const uint nneg = uint(neg.size());
+
+    // Every subset of the first layer needs at least one positive and one negative example
+    uint nparts = numParts_;
+    while ( nparts > 1 && (nparts > npos || nparts > nneg))
+        nparts >>= 1;
+
+    // Randomly partition the examples into subsets of (near) equal class balance
+    vector<uint> pidxs( npos), nidxs( nneg);
+    for ( uint i = 0; i < npos; ++i)
+        pidxs[i] = i;
+    for ( uint i = 0; i < nneg; ++i)
+        nidxs[i] = i;
+    shuffle( pidxs);
+    shuffle( nidxs);
+
+    vector<Subset> parts( nparts);
+    for ( uint i = 0; i < npos; ++i)
+        parts[i % nparts].pos.push_back( pidxs[i]);
+    for ( uint i = 0; i < nneg; ++i)
+        parts[i % nparts].neg.push_back( nidxs[i]);
+    for ( uint p = 0; p < nparts; ++p)
+    {
+        std::sort( parts[p].pos.begin(), parts[p].pos.end());
+        std::sort( parts[p].neg.begin(), parts[p].neg.end());
+        parts[p].posAlphas.assign( parts[p].pos.size(), 0);
+        parts[p].negAlphas.assign( parts[p].neg.size(), 0);
+        parts[p].warm = false;
+    }   // end for
+
+    pos_ = &pos;
+    neg_ = &neg;
+    vector<int> pwhere( npos, -1), nwhere( nneg, -1);
+    Subset fb;  // Support vectors of the last layer of the previous pass
+    SVMClassifier::Ptr svmc;
+    const WorkerPool::Job job = boost::bind( &CascadeSVMTrainer::work, this, _1);
+
+    while ( numPasses_ < maxPasses_)
+    {
+        numPasses_++;
+        layer_ = parts;
+        if ( numPasses_ > 1)
+        {
+            // Feed the last support vectors (with their multipliers) back into every
+            // first layer subset. The subset's other examples start from zero.
+            for ( uint p = 0; p < layer_.size(); ++p)
+            {
+                Subset s = fb;
+                mergeInto( s.pos, s.posAlphas, layer_[p].pos, layer_[p].posAlphas, pwhere);
+                mergeInto( s.neg, s.negAlphas, layer_[p].neg, layer_[p].negAlphas, nwhere);
+                s.warm = true;
+                layer_[p] = s;
+            }   // end for
+        }   // end if
+
+        // Train the layers in parallel until only a single subset remains
+        while ( layer_.size() > 1)
+        {
+            nextSubset_ = 0;
+            workers_->run( job);
+
+            vector<Subset> next( (layer_.size() + 1) / 2);
+            for ( uint p = 0; p < next.size(); ++p)
+            {
+                next[p] = layer_[2*p];
+                next[p].warm = true;
+                if ( 2*p + 1 < layer_.size())
+                {
+                    const Subset &s = layer_[2*p+1];
+                    mergeInto( next[p].pos, next[p].posAlphas, s.pos, s.posAlphas, pwhere);
+                    mergeInto( next[p].neg, next[p].negAlphas, s.neg, s.negAlphas, nwhere);
+                }   // end if
+            }   // end for
+            layer_.swap( next);
+        }   // end while
+
+        // Train the last layer with all the cores
+        Subset &last = layer_[0];
+        svmc = trainSubset( last, workers_->size(), svmp_.cacheSize());
+        assert( svmc);
+
+        const bool same = numPasses_ > 1 && sorted( last.pos) == sorted( fb.pos)
+                                         && sorted( last.neg) == sorted( fb.neg);
+        fb = last;
+        if ( same)
+        {
+            converged_ = true;
+            break;
+        }   // end if
+    }   // end while
+
+    layer_.clear();
+    pos_ = NULL;
+    neg_ = NULL;
+    return svmc;
+}   // end train
+
+
+SVMClassifier::Ptr CascadeSVMTrainer::trainSubset( Subset &s, uint nthreads, double cacheMB) const
+{
+    vector<cv::Mat_<float> > pos, neg;
+    for ( uint k = 0; k < s.pos.size(); ++k)
+        pos.push_back( (*pos_)[s.pos[k]]);
+    for ( uint k = 0; k < s.neg.size(); ++k)
+        neg.push_back( (*neg_)[s.neg[k]]);
+
+    SVMTrainer<cv::Mat_<float> > svmt( kernel_, svmp_.cost(), svmp_.eps(), nthreads, cacheMB);
+    const SVMClassifier::Ptr svmc = s.warm ? svmt.train( pos, neg, s.posAlphas, s.negAlphas)
+                                           : svmt.train( pos, neg);
+    svmt.getAlphas( s.posAlphas, s.negAlphas);
+
+    // Keep only the support vectors (as the trainer's classifier does)
+    uint m = 0;
+    for ( uint k = 0; k < s.pos.size(); ++k)
+    {
+        if ( !SVMTrainer<cv::Mat_<float> >::isSupportVector( s.posAlphas[k]))
+            continue;
+        s.pos[m] = s.pos[k];
+        s.posAlphas[m++] = s.posAlphas[k];
+    }   // end for
+    s.pos.resize(m);
+    s.posAlphas.resize(m);
+
+    m = 0;
+    for ( uint k = 0; k < s.neg.size(); ++k)
+    {
+        if ( !SVMTrainer<cv::Mat_<float> >::isSupportVector( s.negAlphas[k]))
+            continue;
+        s.neg[m] = s.neg[k];
+        s.negAlphas[m++] = s.negAlphas[k];
+    }   // end for
+    s.neg.resize(m);
+    s.negAlphas.resize(m);
+
+    return svmc;
+}   // end trainSubset
+
+
+void CascadeSVMTrainer::work( uint t)
+{
+    // Split the budget over the subsets trained at once (0 stays unlimited)
+    const uint nconc = std::max<uint>( 1, std::min<uint>( workers_->size(), uint(layer_.size())));
+    const double localMB = svmp_.cacheSize() / nconc;
+    while ( true)
+    {
+        uint p;
+        {
+            boost::mutex::scoped_lock lock( mutex_);
+            if ( nextSubset_ >= layer_.size())
+                break;
+            p = nextSubset_++;
+        }   // end lock
+        trainSubset( layer_[p], 1, localMB);
+    }   // end while
+}   // end work
@@ -207,6 +207,29 @@ void CrossValidator::sampleWithReplacement( const vector<cv::Mat_<float> > &pop,
 
 
 
+// static
+void CrossValidator::sampleWithReplacement( const vector<cv::Mat_<float> > &pop,
+                                                  vector<cv::Mat_<float> > &sample, vector<double> &counts,
+                                                  int sz, rlib::Random& rnd, vector<uint> *popIdxs)
+{
+    const int psz = pop.size();
+    vector<int> draws( psz, 0);
+    for ( int i = 0; i < sz; ++i)
+        draws[ rnd.getRandomInt() % psz]++;
+
+    for ( int i = 0; i < psz; ++i)
+    {
+        if ( draws[i] == 0)
+            continue;
+        sample.push_back( pop[i]);
+        counts.push_back( draws[i]);
+        if ( popIdxs)
+            popIdxs->push_back( i);
+    }   // end for
+}   // end sampleWithReplacement
+
+
+
 // static
 unordered_set<int> CrossValidator::sampleWithoutReplacement( const vector<cv::Mat_<float> > &pop,
                                                              vector<cv::Mat_<float> > &sample, int sz, rlib::Random& rnd)
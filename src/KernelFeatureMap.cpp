@@ -0,0 +1,207 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "KernelFeatureMap.h"
+using RLearning::KernelFeatureMap;
+using RLearning::RandomFourierMap;
+using RLearning::NystroemMap;
+using RLearning::KernelApproxStats;
+#include "LinearSVMTrainer.h"
+using RLearning::LinearSVMTrainer;
+#include "VectorOps.h"
+using RLearning::dotProduct;
+using RLearning::dotProductRows;
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+
+KernelFeatureMap::Ptr KernelFeatureMap::create( const SVMParams &svmp, const vector<cv::Mat_<float> > &xs, int D, uint seed)
+{
+    if ( svmp.isLinear() || xs.empty())
+        return Ptr();
+
+    if ( svmp.isRBF())
+        return Ptr( new RandomFourierMap( (int)xs[0].total(), svmp.gamma(), D, seed));
+
+    // Landmarks as a random sample (without replacement) of up to D examples
+    vector<uint> idxs( xs.size());
+    for ( uint i = 0; i < idxs.size(); ++i)
+        idxs[i] = i;
+    cv::RNG rng( seed);
+    const uint m = std::min<uint>( D, uint(idxs.size()));
+    vector<cv::Mat_<float> > landmarks( m);
+    for ( uint i = 0; i < m; ++i)
+    {
+        std::swap( idxs[i], idxs[i + rng.uniform( 0, int(idxs.size() - i))]);
+        landmarks[i] = xs[idxs[i]];
+    }   // end for
+    return Ptr( new NystroemMap( svmp.makeKernel<cv::Mat_<float> >(), landmarks));
+}   // end create
+
+
+cv::Mat_<float> KernelFeatureMap::map( const cv::Mat_<float> &x) const
+{
+    assert( (int)x.total() == inputDims());
+    const cv::Mat_<float> cx = x.isContinuous() ? x : cv::Mat_<float>( x.clone());
+    cv::Mat_<float> z( 1, outputDims());
+    map( cx.ptr<float>(0), z.ptr<float>(0));
+    return z;
+}   // end map
+
+
+vector<cv::Mat_<float> > KernelFeatureMap::map( const vector<cv::Mat_<float> > &xs) const
+{
+    vector<cv::Mat_<float> > zs( xs.size());
+    for ( uint i = 0; i < xs.size(); ++i)
+        zs[i] = map( xs[i]);
+    return zs;
+}   // end map
+
+
+SVMClassifier::Ptr KernelFeatureMap::train( const vector<cv::Mat_<float> > &pos, const vector<cv::Mat_<float> > &neg,
+                                            const SVMParams &svmp, uint maxIts) const
+{
+    LinearSVMTrainer<cv::Mat_<float> > trainer( svmp.cost(), svmp.eps(), maxIts);
+    return trainer.train( map( pos), map( neg));
+}   // end train
+
+
+float KernelFeatureMap::predict( const SVMClassifier &svmc, const cv::Mat_<float> &x) const
+{
+    return svmc.predict( map( x));
+}   // end predict
+
+
+KernelApproxStats KernelFeatureMap::measureApproximation( const KernelFunc<cv::Mat_<float> > &kernel,
+                                                          const vector<cv::Mat_<float> > &xs,
+                                                          uint numPairs, uint seed) const
+{
+    KernelApproxStats stats;
+    stats.numPairs = 0;
+    stats.meanAbsError = 0;
+    stats.maxAbsError = 0;
+    stats.rmsError = 0;
+    if ( xs.empty())
+        return stats;
+
+    cv::RNG rng( seed);
+    const int n = int(xs.size());
+    for ( uint p = 0; p < numPairs; ++p)
+    {
+        const int i = rng.uniform( 0, n);
+        const int j = rng.uniform( 0, n);
+        const cv::Mat_<float> zi = map( xs[i]);
+        const cv::Mat_<float> zj = map( xs[j]);
+        const double approx = dotProduct( zi.ptr<float>(0), zj.ptr<float>(0), outputDims());
+        const double err = fabs( approx - kernel( xs[i], xs[j]));
+        stats.meanAbsError += err;
+        stats.rmsError += err*err;
+        stats.maxAbsError = std::max( stats.maxAbsError, err);
+        stats.numPairs++;
+    }   // end for
+
+    if ( stats.numPairs > 0)
+    {
+        stats.meanAbsError /= stats.numPairs;
+        stats.rmsError = sqrt( stats.rmsError / stats.numPairs);
+    }   // end if
+    return stats;
+}   // end measureApproximation
+
+
+
+RandomFourierMap::RandomFourierMap( int dims, double gam, int D, uint seed)
+    : W_( D, dims), wps_( D), b_( D), scale_( float( sqrt( 2.0 / D)))
+{
+    assert( D > 0 && dims > 0);
+    cv::RNG rng( seed);
+    const double sigma = sqrt( 2*gam);
+    for ( int r = 0; r < D; ++r)
+    {
+        float *w = W_.ptr<float>(r);
+        for ( int c = 0; c < dims; ++c)
+            w[c] = float( rng.gaussian( sigma));
+        wps_[r] = w;
+        b_[r] = float( rng.uniform( 0.0, 2*CV_PI));
+    }   // end for
+}   // end ctor
+
+
+void RandomFourierMap::map( const float *x, float *z) const
+{
+    const int D = W_.rows;
+    dotProductRows( x, NULL, &wps_[0], D, W_.cols, z, NULL);
+    for ( int r = 0; r < D; ++r)
+        z[r] = scale_ * cosf( z[r] + b_[r]);
+}   // end map
+
+
+
+NystroemMap::NystroemMap( const KernelFunc<cv::Mat_<float> >::Ptr kernel,
+                          const vector<cv::Mat_<float> > &landmarks, double relTol)
+    : kernel_(kernel)
+{
+    assert( !landmarks.empty());
+    const int m = int(landmarks.size());
+    const int dims = int(landmarks[0].total());
+    L_.create( m, dims);
+    lps_.resize( m);
+    lsqs_.resize( m);
+    for ( int i = 0; i < m; ++i)
+    {
+        assert( (int)landmarks[i].total() == dims);
+        landmarks[i].reshape( 1, 1).copyTo( L_.row(i));
+        lps_[i] = L_.ptr<float>(i);
+        lsqs_[i] = dotProduct( lps_[i], lps_[i], dims);
+    }   // end for
+
+    // Kernel matrix of the landmarks
+    cv::Mat_<float> K( m, m);
+    for ( int i = 0; i < m; ++i)
+        kernel_->normRow( lps_[i], lsqs_[i], &lps_[0], &lsqs_[0], m, dims, K.ptr<float>(i));
+    K = 0.5f * (K + K.t());    // Symmetric against rounding
+
+    // Eigenvalues returned in descending order with the eigenvectors in the rows of U
+    cv::Mat_<double> evals, U;
+    cv::eigen( cv::Mat_<double>(K), evals, U);
+    int r = 0;
+    while ( r < m && evals(r) > relTol * std::max( evals(0), 0.0))
+        r++;
+
+    P_.create( std::max( r, 1), m);
+    P_ = 0;
+    for ( int i = 0; i < r; ++i)
+    {
+        const double s = 1.0 / sqrt( evals(i));
+        float *p = P_.ptr<float>(i);
+        for ( int k = 0; k < m; ++k)
+            p[k] = float( s * U(i,k));
+    }   // end for
+    pps_.resize( P_.rows);
+    for ( int i = 0; i < P_.rows; ++i)
+        pps_[i] = P_.ptr<float>(i);
+}   // end ctor
+
+
+void NystroemMap::map( const float *x, float *z) const
+{
+    const int m = L_.rows;
+    vector<float> kx( m);
+    kernel_->normRow( x, dotProduct( x, x, L_.cols), &lps_[0], &lsqs_[0], m, L_.cols, &kx[0]);
+    dotProductRows( &kx[0], NULL, &pps_[0], P_.rows, m, z, NULL);
+}   // end map
@@ -0,0 +1,147 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include <MultiSVMClassifier.h>
+using RLearning::MultiSVMClassifier;
+using RLearning::dotProduct;
+#include <cassert>
+#include <algorithm>
+
+
+MultiSVMClassifier::MultiSVMClassifier( const SVMParams &svmp, Scheme scheme, const vector<int> &classes,
+                                        const vector<cv::Mat_<float> > &svs)
+    : svmp_(svmp), scheme_(scheme), classes_(classes),
+      kernel_( svmp.makeKernel<cv::Mat_<float> >()), converged_(true)
+{
+    assert( classes_.size() >= 2);
+    for ( uint i = 0; i < svs.size(); ++i)
+    {
+        // Copy so the support vectors are continuous and don't refer to the training data
+        svs_.push_back( svs[i].clone());
+        const float *x = svs_[i].ptr<float>(0);
+        svps_.push_back( x);
+        svsqs_.push_back( dotProduct( x, x, svs_[i].total()));
+    }   // end for
+}   // end ctor
+
+
+void MultiSVMClassifier::addProblem( int posClass, int negClass, const vector<uint> &svIdxs,
+                                     const vector<double> &coefs, double b, bool converged)
+{
+    assert( svIdxs.size() == coefs.size());
+    assert( posClass >= 0 && posClass < (int)classes_.size() && negClass < (int)classes_.size());
+    Problem p;
+    p.posClass = posClass;
+    p.negClass = negClass;
+    p.svIdxs = svIdxs;
+    p.coefs = coefs;
+    p.b = b;
+    problems_.push_back(p);
+    converged_ = converged_ && converged;
+}   // end addProblem
+
+
+void MultiSVMClassifier::getProblemClasses( uint p, int &posClass, int &negClass) const
+{
+    posClass = problems_[p].posClass;
+    negClass = problems_[p].negClass;
+}   // end getProblemClasses
+
+
+// private
+void MultiSVMClassifier::kernelRow( const float *z, int n, vector<float> &kz) const
+{
+    kz.resize( svps_.size());
+    if ( svps_.empty())
+        return;
+    const double zsq = dotProduct( z, z, n);
+    kernel_->normRow( z, zsq, &svps_[0], &svsqs_[0], uint(svps_.size()), n, &kz[0]);
+}   // end kernelRow
+
+
+// private
+void MultiSVMClassifier::decisionValues( const vector<float> &kz, int n, vector<float> &dvs) const
+{
+    dvs.resize( problems_.size());
+    for ( uint p = 0; p < problems_.size(); ++p)
+    {
+        const Problem &prob = problems_[p];
+        double res = -prob.b;
+        for ( uint k = 0; k < prob.svIdxs.size(); ++k)
+            res += prob.coefs[k] * kz[prob.svIdxs[k]];
+        dvs[p] = float(res / n);   // Normalise by the vector length
+    }   // end for
+}   // end decisionValues
+
+
+// private
+int MultiSVMClassifier::decide( const vector<float> &dvs) const
+{
+    int best = 0;
+    if ( scheme_ == OneVsRest)
+    {
+        // Class with the largest decision value
+        for ( uint p = 1; p < problems_.size(); ++p)
+            if ( dvs[p] > dvs[best])
+                best = int(p);
+        return classes_[problems_[best].posClass];
+    }   // end if
+
+    // One vote per pairwise problem (ties go to the lowest class)
+    vector<int> votes( classes_.size(), 0);
+    for ( uint p = 0; p < problems_.size(); ++p)
+        votes[ dvs[p] >= 0 ? problems_[p].posClass : problems_[p].negClass]++;
+    for ( uint c = 1; c < votes.size(); ++c)
+        if ( votes[c] > votes[best])
+            best = int(c);
+    return classes_[best];
+}   // end decide
+
+
+void MultiSVMClassifier::decisionValues( const cv::Mat_<float> &z, vector<float> &dvs) const
+{
+    if ( !z.isContinuous())
+    {
+        decisionValues( cv::Mat_<float>( z.clone()), dvs);
+        return;
+    }   // end if
+
+    vector<float> kz;
+    kernelRow( z.ptr<float>(0), z.total(), kz);
+    decisionValues( kz, z.total(), dvs);
+}   // end decisionValues
+
+
+int MultiSVMClassifier::predict( const cv::Mat_<float> &z) const
+{
+    vector<float> dvs;
+    decisionValues( z, dvs);
+    return decide( dvs);
+}   // end predict
+
+
+void MultiSVMClassifier::predict( const cv::Mat_<float> &zs, vector<int> &labels) const
+{
+    labels.resize( zs.rows);
+    vector<float> kz, dvs;  // Reused over the rows
+    for ( int i = 0; i < zs.rows; ++i)
+    {
+        kernelRow( zs.ptr<float>(i), zs.cols, kz);
+        decisionValues( kz, zs.cols, dvs);
+        labels[i] = decide( dvs);
+    }   // end for
+}   // end predict
@@ -0,0 +1,191 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "MultiSVMTrainer.h"
+using RLearning::MultiSVMTrainer;
+#include "SVMTrainer.h"
+using RLearning::SVMTrainer;
+#include <cassert>
+#include <algorithm>
+#include <boost/bind.hpp>
+
+
+MultiSVMTrainer::MultiSVMTrainer( const SVMParams &svmp, MultiSVMClassifier::Scheme scheme, uint nthreads)
+    : svmp_(svmp), scheme_(scheme), workers_( new WorkerPool( nthreads)), hitRate_(0),
+      nextProblem_(0), xs_(NULL)
+{
+}   // end ctor
+
+
+MultiSVMTrainer::~MultiSVMTrainer()
+{
+    delete workers_;
+}   // end dtor
+
+
+MultiSVMClassifier::Ptr MultiSVMTrainer::train( const cv::Mat_<float> &xs, const cv::Mat_<int> &labels)
+{
+    assert( (int)labels.total() == xs.rows);
+    const cv::Mat_<float> cxs = xs.isContinuous() ? xs : cv::Mat_<float>( xs.clone());
+    const uint n = cxs.rows;
+
+    // Class indices of each example (classes in ascending order of label)
+    vector<int> classes;
+    for ( uint i = 0; i < n; ++i)
+        classes.push_back( labels(i));
+    std::sort( classes.begin(), classes.end());
+    classes.erase( std::unique( classes.begin(), classes.end()), classes.end());
+    if ( classes.size() < 2)
+        return MultiSVMClassifier::Ptr();
+
+    const uint nc = classes.size();
+    vector<vector<uint> > members( nc);
+    for ( uint i = 0; i < n; ++i)
+    {
+        const int c = int( std::lower_bound( classes.begin(), classes.end(), labels(i)) - classes.begin());
+        members[c].push_back(i);
+    }   // end for
+
+    problems_.clear();
+    for ( uint c = 0; c < nc; ++c)
+    {
+        if ( scheme_ == MultiSVMClassifier::OneVsRest)
+        {
+            Problem p;
+            p.posClass = c;
+            p.negClass = -1;
+            p.pos = members[c];
+            for ( uint d = 0; d < nc; ++d)
+                if ( d != c)
+                    p.neg.insert( p.neg.end(), members[d].begin(), members[d].end());
+            problems_.push_back(p);
+        }   // end if
+        else
+        {
+            for ( uint d = c+1; d < nc; ++d)
+            {
+                Problem p;
+                p.posClass = c;
+                p.negClass = d;
+                p.pos = members[c];
+                p.neg = members[d];
+                problems_.push_back(p);
+            }   // end for
+        }   // end else
+    }   // end for
+
+    vector<const float*> xps( n);
+    for ( uint i = 0; i < n; ++i)
+        xps[i] = cxs.ptr<float>(i);
+    const KernelFunc<cv::Mat_<float> >::Ptr kernel = svmp_.makeKernel<cv::Mat_<float> >();
+    cache_.reset( new SharedKernelCache<cv::Mat_<float> >( kernel, xps, cxs.cols, svmp_.cacheSize()));
+    xs_ = &cxs;
+    nextProblem_ = 0;
+
+    const WorkerPool::Job job = boost::bind( &MultiSVMTrainer::work, this, _1);
+    workers_->run( job);
+
+    hitRate_ = cache_->hitRate();
+    cache_.reset();
+    xs_ = NULL;
+
+    // Pool the support vectors of all the problems (each example at most once) using
+    // the same test as the binary trainer's classifiers so tiny multipliers are dropped
+    vector<int> svIdx( n, -1);
+    vector<cv::Mat_<float> > svs;
+    for ( uint p = 0; p < problems_.size(); ++p)
+    {
+        const Problem &prob = problems_[p];
+        for ( uint k = 0; k < prob.pos.size() + prob.neg.size(); ++k)
+        {
+            const bool isPos = k < prob.pos.size();
+            const uint g = isPos ? prob.pos[k] : prob.neg[k - prob.pos.size()];
+            const double a = isPos ? prob.posAlphas[k] : prob.negAlphas[k - prob.pos.size()];
+            if ( SVMTrainer<cv::Mat_<float> >::isSupportVector( a) && svIdx[g] < 0)
+            {
+                svIdx[g] = int(svs.size());
+                svs.push_back( cxs.row(g));
+            }   // end if
+        }   // end for
+    }   // end for
+
+    MultiSVMClassifier::Ptr mcfier( new MultiSVMClassifier( svmp_, scheme_, classes, svs));
+    for ( uint p = 0; p < problems_.size(); ++p)
+    {
+        const Problem &prob = problems_[p];
+        vector<uint> idxs;
+        vector<double> coefs;
+        for ( uint k = 0; k < prob.pos.size(); ++k)
+        {
+            if ( !SVMTrainer<cv::Mat_<float> >::isSupportVector( prob.posAlphas[k]))
+                continue;
+            idxs.push_back( uint( svIdx[prob.pos[k]]));
+            coefs.push_back( prob.posAlphas[k]);
+        }   // end for
+        for ( uint k = 0; k < prob.neg.size(); ++k)
+        {
+            if ( !SVMTrainer<cv::Mat_<float> >::isSupportVector( prob.negAlphas[k]))
+                continue;
+            idxs.push_back( uint( svIdx[prob.neg[k]]));
+            coefs.push_back( -prob.negAlphas[k]);
+        }   // end for
+        mcfier->addProblem( prob.posClass, prob.negClass, idxs, coefs, prob.b, prob.converged);
+    }   // end for
+
+    problems_.clear();
+    return mcfier;
+}   // end train
+
+
+void MultiSVMTrainer::work( uint t)
+{
+    const cv::Mat_<float> &xs = *xs_;
+    // Each worker keeps its own (smaller) row cache of values gathered from the shared cache
+    const double localMB = svmp_.cacheSize() / workers_->size();
+    while ( true)
+    {
+        uint p;
+        {
+            boost::mutex::scoped_lock lock( mutex_);
+            if ( nextProblem_ >= problems_.size())
+                break;
+            p = nextProblem_++;
+        }   // end lock
+
+        Problem &prob = problems_[p];
+        vector<cv::Mat_<float> > pos, neg;
+        vector<uint> gidxs;
+        for ( uint k = 0; k < prob.pos.size(); ++k)
+        {
+            pos.push_back( xs.row( prob.pos[k]));
+            gidxs.push_back( prob.pos[k]);
+        }   // end for
+        for ( uint k = 0; k < prob.neg.size(); ++k)
+        {
+            neg.push_back( xs.row( prob.neg[k]));
+            gidxs.push_back( prob.neg[k]);
+        }   // end for
+
+        SVMTrainer<cv::Mat_<float> > svmt( cache_->getKernel(), svmp_.cost(), svmp_.eps(), 1, localMB);
+        svmt.setSharedCache( cache_, gidxs);
+        const SVMClassifier::Ptr svmc = svmt.train( pos, neg);
+        assert( svmc);
+        svmt.getAlphas( prob.posAlphas, prob.negAlphas);
+        prob.b = svmc->getThreshold();
+        prob.converged = svmc->isConverged();
+    }   // end while
+}   // end work
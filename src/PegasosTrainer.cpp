@@ -0,0 +1,227 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "PegasosTrainer.h"
+using RLearning::PegasosTrainer;
+#include "VectorOps.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <boost/bind.hpp>
+
+const double PegasosTrainer::BIAS = 1;
+const uint PegasosTrainer::SYNCBATCHES = 16;
+
+
+PegasosTrainer::PegasosTrainer( const cv::Size &xsize, double lambda, uint batchSize, uint nthreads)
+    : xsize_(xsize), dims_(xsize.area()), lambda_(lambda), batchSize_( std::max<uint>( 1, batchSize)),
+      workers_( new WorkerPool( nthreads)), source_(NULL), maxExamples_(0), exhausted_(false)
+{
+    assert( lambda > 0);
+    local_.resize( workers_->size());
+    localBatches_.resize( workers_->size());
+    reset();
+}   // end ctor
+
+
+PegasosTrainer::~PegasosTrainer()
+{
+    delete workers_;
+}   // end dtor
+
+
+void PegasosTrainer::reset()
+{
+    boost::mutex::scoped_lock lock( wMutex_);
+    w_.assign( dims_+1, 0);
+    steps_ = 0;
+    numExamples_ = 0;
+    numBatches_ = 0;
+    numPos_ = 0;
+    numNeg_ = 0;
+}   // end reset
+
+
+void PegasosTrainer::train( const Source &source, size_t maxExamples)
+{
+    source_ = &source;
+    maxExamples_ = maxExamples > 0 ? numExamples_ + maxExamples : 0;
+    exhausted_ = false;
+    const WorkerPool::Job job = boost::bind( &PegasosTrainer::work, this, _1);
+    const uint nw = workers_->size();
+    vector<double> avg( dims_+1);
+    while ( !exhausted_)
+    {
+        for ( uint t = 0; t < nw; ++t)  // Only this thread writes w_ so it's read without locking
+        {
+            local_[t] = w_;
+            localBatches_[t] = 0;
+        }   // end for
+        workers_->run( job);
+
+        // Average the weights of the workers that applied batches
+        std::fill( avg.begin(), avg.end(), 0);
+        uint nused = 0;
+        size_t most = 0;
+        for ( uint t = 0; t < nw; ++t)
+        {
+            if ( localBatches_[t] == 0)
+                continue;
+            for ( int k = 0; k <= dims_; ++k)
+                avg[k] += local_[t][k];
+            nused++;
+            most = std::max( most, localBatches_[t]);
+        }   // end for
+        if ( nused == 0)
+            break;
+
+        boost::mutex::scoped_lock lock( wMutex_);
+        for ( int k = 0; k <= dims_; ++k)
+            w_[k] = avg[k] / nused;
+        steps_ += most;
+    }   // end while
+    source_ = NULL;
+}   // end train
+
+
+SVMClassifier::Ptr PegasosTrainer::snapshot() const
+{
+    // The weights as of the last averaging (workers' updates since aren't included)
+    cv::Mat_<float> w( xsize_.height, xsize_.width);
+    float *wp = w.ptr<float>(0);
+    double b;
+    {
+        boost::mutex::scoped_lock lock( wMutex_);
+        for ( int k = 0; k < dims_; ++k)
+            wp[k] = float(w_[k]);
+        b = -w_[dims_]*BIAS;    // The classifier gives z.dot(w) - b so the threshold is the negated bias term
+    }   // end lock
+
+    size_t nex, npos, nneg;
+    {
+        boost::mutex::scoped_lock lock( srcMutex_);
+        nex = numExamples_;
+        npos = numPos_;
+        nneg = numNeg_;
+    }   // end lock
+
+    const double cost = 1.0 / (lambda_ * std::max<size_t>( 1, nex));
+    SVMParams svmp( cost, 0);
+    return SVMClassifier::Ptr( new SVMClassifier( svmp, w, b, 0, npos, nneg));
+}   // end snapshot
+
+
+size_t PegasosTrainer::getNumExamples() const
+{
+    boost::mutex::scoped_lock lock( srcMutex_);
+    return numExamples_;
+}   // end getNumExamples
+
+
+size_t PegasosTrainer::getNumBatches() const
+{
+    boost::mutex::scoped_lock lock( srcMutex_);
+    return numBatches_;
+}   // end getNumBatches
+
+
+// private
+void PegasosTrainer::work( uint wt)
+{
+    vector<cv::Mat_<float> > xs;
+    vector<int> ys;
+    vector<double> g( dims_+1);
+    vector<float> xbuf( dims_);  // For any examples that aren't continuous
+    double *w = &local_[wt][0];
+    const double radius = 1.0 / sqrt(lambda_);  // The optimal weights lie within this ball
+
+    while ( localBatches_[wt] < SYNCBATCHES)
+    {
+        xs.clear();
+        ys.clear();
+        {
+            boost::mutex::scoped_lock lock( srcMutex_);
+            if ( exhausted_)    // By another worker
+                break;
+            uint want = batchSize_;
+            if ( maxExamples_ > 0)
+            {
+                if ( numExamples_ >= maxExamples_)
+                {
+                    exhausted_ = true;
+                    break;
+                }   // end if
+                want = uint( std::min<size_t>( want, maxExamples_ - numExamples_));
+            }   // end if
+            const uint got = (*source_)( xs, ys, want);
+            if ( got == 0)
+            {
+                exhausted_ = true;
+                break;
+            }   // end if
+            assert( xs.size() == got && ys.size() == got);
+            numExamples_ += got;
+            for ( uint i = 0; i < got; ++i)
+                (ys[i] > 0 ? numPos_ : numNeg_)++;
+            numBatches_++;
+        }   // end lock
+        const size_t t = steps_ + (++localBatches_[wt]);   // This worker's iteration count
+
+        // Sum the sub-gradient of the hinge loss over the examples inside the margin
+        std::fill( g.begin(), g.end(), 0);
+        for ( uint i = 0; i < xs.size(); ++i)
+        {
+            const cv::Mat_<float> &x = xs[i];
+            assert( (int)x.total() == dims_);
+            const float *xp = x.ptr<float>(0);
+            if ( !x.isContinuous())
+            {
+                for ( int r = 0; r < x.rows; ++r)
+                    memcpy( &xbuf[r*x.cols], x.ptr<float>(r), x.cols * sizeof(float));
+                xp = &xbuf[0];
+            }   // end if
+
+            const double y = ys[i] > 0 ? 1 : -1;
+            if ( y * (dotProduct( w, xp, dims_) + w[dims_]*BIAS) < 1)
+            {
+                addScaled( &g[0], y, xp, dims_);
+                g[dims_] += y * BIAS;
+            }   // end if
+        }   // end for
+
+        // Step size 1/(lambda*t) giving w = (1 - 1/t)*w + eta/|batch| * g
+        const double eta = 1.0 / (lambda_ * t);
+        const double shrink = 1.0 - 1.0/t;
+        const double step = eta / xs.size();
+        double sqnorm = 0;
+        for ( int k = 0; k <= dims_; ++k)
+        {
+            const double v = shrink * w[k] + step * g[k];
+            w[k] = v;
+            sqnorm += v * v;
+        }   // end for
+
+        // Project back onto the ball of radius 1/sqrt(lambda)
+        if ( sqnorm > radius*radius)
+        {
+            const double s = radius / sqrt(sqnorm);
+            for ( int k = 0; k <= dims_; ++k)
+                w[k] *= s;
+        }   // end if
+    }   // end while
+}   // end work
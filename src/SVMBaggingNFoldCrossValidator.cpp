@@ -19,13 +19,14 @@
 using RLearning::SVMBaggingNFoldCrossValidator;
 #include <cassert>
 #include <cstdlib>
+#include <algorithm>
 
 
 SVMBaggingNFoldCrossValidator::SVMBaggingNFoldCrossValidator( const SVMParams &svmp, int numc, int nf,
                     const cv::Mat_<float>& xs, const cv::Mat_<int>& labels, int numEVs)
     : NFoldCrossValidator( nf, xs, labels, numEVs),
     _kernel( svmp.makeKernel<cv::Mat_<float> >()), _cost(svmp.cost()), _eps(svmp.eps()),
-    _nfolds(nf), _numClassifiers( numc < 2 ? 2 : numc)
+    _nfolds(nf), _numClassifiers( numc < 2 ? 2 : numc), _cacheMB( svmp.cacheSize()), _numGroups(1), _hitRate(0)
 {
 }   // end ctor
 
@@ -33,25 +34,40 @@ SVMBaggingNFoldCrossValidator::SVMBaggingNFoldCrossValidator( const SVMParams &s
 
 // private - thread function
 void SVMBaggingNFoldCrossValidator::trainGroup( int si, int numClassifiers,
-                const vector<cv::Mat_<float> >* pset, const vector<cv::Mat_<float> >* nset)
+                const vector<cv::Mat_<float> >* pset, const vector<cv::Mat_<float> >* nset,
+                const cv::Mat_<float>* pool)
 {
     rlib::Random rnd0( si + numClassifiers);
     rlib::Random rnd1( 2*si + 2*numClassifiers + 2);
     const int fi = si + numClassifiers;
-    for ( int i = si; i < fi; ++i)
-    {
-        vector<cv::Mat_<float> > tps, tns;   // This classifier's training data
-        CrossValidator::sampleWithReplacement( *pset, tps, pset->size(), rnd0);
-        CrossValidator::sampleWithReplacement( *nset, tns, nset->size(), rnd1);
 
 #ifdef NDEBUG
-        int nthreads = boost::thread::hardware_concurrency();
+    int nthreads = boost::thread::hardware_concurrency();
 #else
-        int nthreads = 1;
+    int nthreads = 1;
 #endif
-        SVMTrainer<cv::Mat_<float> > svmt( _kernel, _cost, _eps, nthreads);
+    // Each group's trainer keeps its own (smaller) row cache of values gathered from the shared cache
+    const double localMB = _cacheMB / _numGroups;
+
+    for ( int i = si; i < fi; ++i)
+    {
+        // This classifier's training data (each example once weighted by the times it was drawn)
+        // as rows of the pool (positives first) which are also their positions in the shared cache.
+        vector<cv::Mat_<float> > tps, tns;
+        vector<double> pws, nws;
+        vector<uint> pidxs, nidxs;
+        CrossValidator::sampleWithReplacement( *pset, tps, pws, pset->size(), rnd0, &pidxs);
+        CrossValidator::sampleWithReplacement( *nset, tns, nws, nset->size(), rnd1, &nidxs);
+        for ( size_t k = 0; k < nidxs.size(); ++k)
+            nidxs[k] += uint(pset->size());
+        vector<uint> gidxs( pidxs);
+        gidxs.insert( gidxs.end(), nidxs.begin(), nidxs.end());
+
+        SVMTrainer<cv::Mat_<float> > svmt( _kernel, _cost, _eps, nthreads, localMB);
         svmt.enableErrorOutput( false);
-        _svmcs[i] = svmt.train( tps, tns);  // Train and set classifier
+        svmt.setExampleWeights( pws, nws);
+        svmt.setSharedCache( _cache, gidxs);
+        _svmcs[i] = svmt.train( TrainingView( *pool, pidxs, nidxs));  // Train in place over the pool
     }   // end for
 }   // end trainGroup
 
@@ -69,12 +85,25 @@ void SVMBaggingNFoldCrossValidator::train( const cv::Mat_<float>& xs, const cv::
     int nthreads = 1;
 #endif
 
+    _numGroups = std::min( nthreads, nc);
     const int chunk = nc / nthreads;
     int rem = nc % nthreads;
 
     vector<cv::Mat_<float> > tpset, tnset;
     CrossValidator::splitIntoPositiveAndNegativeClasses( xs, labels, tpset, tnset);
 
+    // Every bag is drawn from the same pool so their trainers share one cache of kernel rows over it
+    const int npos = tpset.size();
+    cv::Mat_<float> pool( npos + (int)tnset.size(), xs.cols);
+    vector<const float*> xps( pool.rows);  // Continuous rows so the trainers can view them in place
+    for ( int i = 0; i < pool.rows; ++i)
+    {
+        const cv::Mat_<float> &x = i < npos ? tpset[i] : tnset[i - npos];
+        x.reshape( 1, 1).copyTo( pool.row(i));
+        xps[i] = pool.ptr<float>(i);
+    }   // end for
+    _cache.reset( new SharedKernelCache<cv::Mat_<float> >( _kernel, xps, pool.cols, _cacheMB));
+
     boost::thread_group tgroup;
     int si = 0;
     for ( int i = 0; i < nthreads; ++i)
@@ -87,11 +116,14 @@ void SVMBaggingNFoldCrossValidator::train( const cv::Mat_<float>& xs, const cv::
             rem--;
         }   // end if
 
-        tgroup.create_thread( boost::bind( &SVMBaggingNFoldCrossValidator::trainGroup, this, si, tchunk, &tpset, &tnset));
+        tgroup.create_thread( boost::bind( &SVMBaggingNFoldCrossValidator::trainGroup, this, si, tchunk, &tpset, &tnset, &pool));
         si += tchunk;
     }   // end for
 
     tgroup.join_all();
+
+    _hitRate = _cache->hitRate();
+    _cache.reset();
 }   // end train
 
 
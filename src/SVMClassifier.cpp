@@ -17,7 +17,11 @@
 
 #include <SVMClassifier.h>
 using RLearning::SVMClassifier;
+using RLearning::dotProduct;
+using RLearning::sparseDot;
+using RLearning::sparseSqNorm;
 #include <cassert>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 using std::ofstream;
@@ -57,7 +61,7 @@ SVMClassifier::SVMClassifier( const SVMParams &svmParams, vector<double> *alphas
                               double threshold, bool dvs, uint np, uint nn)
     : as( alphas), xs( supportVectors), // supportVectors are the training instances that define the hyperplane boundary
       b( threshold), numSVs( alphas->size()),
-      delVecs(dvs), numPos(np), numNeg(nn)
+      delVecs(dvs), numPos(np), numNeg(nn), converged(true)
 {
     setKernel( svmParams);
     assert( numSVs == xs->size() && numSVs > 0);
@@ -81,6 +85,19 @@ SVMClassifier::SVMClassifier( const SVMParams &svmParams, vector<double> *alphas
 
         deleteVectors();    // Don't need training data to use the linear classifier (because the support vectors give all the info needed)
     }   // end if
+    else
+        setSupportVectorPointers();
+}   // end ctor
+
+
+
+SVMClassifier::SVMClassifier( const SVMParams &svmParams, const cv::Mat_<float> &w, double threshold,
+                              uint nsvs, uint np, uint nn)
+    : as(NULL), xs(NULL), b( threshold), numSVs( nsvs), linx( w.clone()),
+      delVecs(false), numPos(np), numNeg(nn), converged(true)
+{
+    setKernel( svmParams);
+    assert( svmp.isLinear());
 }   // end ctor
 
 
@@ -94,15 +111,28 @@ SVMClassifier::~SVMClassifier()
 class KernelThreadFunc
 {
 public:
-    KernelThreadFunc( const vector<double>* as, const KernelFunc<cv::Mat_<float> >::Ptr krn, const vector<cv::Mat_<float> >* xs)
-        : _as(as), _krn(krn), _xs(xs) {}
+    KernelThreadFunc( const vector<double>* as, const KernelFunc<cv::Mat_<float> >::Ptr krn,
+                      const vector<const float*>* svps, const vector<double>* svsqs)
+        : _as(as), _krn(krn), _svps(svps), _svsqs(svsqs) {}
 
+    // Kernel values are found against chunks of support vectors at a time with a single call
+    // to the kernel (into a buffer on the stack) so the concrete kernel is dispatched once per chunk.
     void calcResult( int soff, int ssz, const cv::Mat_<float>* z)
     {
+        static const int CHUNK = 256;
+        float kz[CHUNK];
+        const float *zp = z->ptr<float>(0);
+        const int n = z->total();
+        const double zsq = dotProduct( zp, zp, n);
         double res = 0;
         const int segMax = soff + ssz;
-        for ( int i = soff; i < segMax; ++i)
-            res += _as->at(i) * (*_krn)( *z, _xs->at(i));
+        for ( int i = soff; i < segMax; i += CHUNK)
+        {
+            const int m = std::min( CHUNK, segMax - i);
+            _krn->normRow( zp, zsq, &(*_svps)[i], &(*_svsqs)[i], m, n, kz);
+            for ( int j = 0; j < m; ++j)
+                res += (*_as)[i+j] * kz[j];
+        }   // end for
         _result = res;
     }   // end operator()
 
@@ -111,7 +141,8 @@ public:
 private:
     const vector<double>* _as;
     const KernelFunc<cv::Mat_<float> >::Ptr _krn;
-    const vector<cv::Mat_<float> >* _xs;
+    const vector<const float*>* _svps;
+    const vector<double>* _svsqs;
     double _result;
 };  // end class 
 
@@ -124,7 +155,10 @@ float SVMClassifier::predict( const cv::Mat_<float>& z) const
 
     double result = -b;
 
-    KernelThreadFunc ktf( as, kernel, xs);
+    if ( !z.isContinuous())
+        return predict( z.clone());
+
+    KernelThreadFunc ktf( as, kernel, &svps, &svsqs);
     ktf.calcResult( 0, numSVs, &z);
     result += ktf.getResult();
     return result / z.total();
@@ -146,7 +180,7 @@ float SVMClassifier::predict( const cv::Mat_<float>& z) const
             rem--;
         }   // end if
 
-        tobjs[i] = new KernelThreadFunc( as, kernel, xs);
+        tobjs[i] = new KernelThreadFunc( as, kernel, &svps, &svsqs);
         tgroup.create_thread( boost::bind( &KernelThreadFunc::calcResult, tobjs[i], segOffset, ssz, &z));  // Start thread
         segOffset += ssz; // Offset for next thread
     }   // end for
@@ -165,6 +199,27 @@ float SVMClassifier::predict( const cv::Mat_<float>& z) const
 
 
 
+float SVMClassifier::predict( const SparseRow &z) const
+{
+    if ( svmp.isLinear())
+        return (sparseDot( z, linx.ptr<float>(0)) - b)/linx.total();
+
+    static const int CHUNK = 256;
+    float kz[CHUNK];
+    const double zsq = sparseSqNorm( z);
+    double result = -b;
+    for ( uint i = 0; i < numSVs; i += CHUNK)
+    {
+        const uint m = std::min<uint>( CHUNK, numSVs - i);
+        kernel->sparseRow( z, zsq, &svps[i], &svsqs[i], m, kz);
+        for ( uint j = 0; j < m; ++j)
+            result += (*as)[i+j] * kz[j];
+    }   // end for
+    return result / (*xs)[0].total();  // Normalise by the vector length
+}   // end predict
+
+
+
 cv::Size SVMClassifier::getModelDims( int *channels) const
 {
     if ( channels != NULL)
@@ -203,6 +258,24 @@ ostream& RLearning::operator<<( ostream &os, const SVMClassifier &svmc)
 
 
 
+// private
+void SVMClassifier::setSupportVectorPointers()
+{
+    svps.clear();
+    svsqs.clear();
+    for ( uint i = 0; i < xs->size(); ++i)
+    {
+        // Ensure each support vector is continuous so it can be read as a raw vector
+        if ( !(*xs)[i].isContinuous())
+            (*xs)[i] = (*xs)[i].clone();
+        const float *x = (*xs)[i].ptr<float>(0);
+        svps.push_back( x);
+        svsqs.push_back( dotProduct( x, x, (*xs)[i].total()));
+    }   // end for
+}   // end setSupportVectorPointers
+
+
+
 // private
 void SVMClassifier::setKernel( const SVMParams &p)
 {
@@ -218,6 +291,7 @@ istream& RLearning::operator>>( istream &is, SVMClassifier &svmc)
     SVMParams svmp;
     is >> svmp;
     svmc.setKernel( svmp);
+    svmc.converged = true;
     string ln, lab;
     while ( getline( is, ln))
     {
@@ -279,6 +353,7 @@ istream& RLearning::operator>>( istream &is, SVMClassifier &svmc)
                 break;
             svmc.xs->push_back((cv::Mat_<float>)m);
         }   // end for
+        svmc.setSupportVectorPointers();
     }   // end else
 
     return is;
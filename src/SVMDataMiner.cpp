@@ -258,12 +258,14 @@ SVMClassifier::Ptr SVMDataMiner::train()
     vector<cv::Mat> negCache;
 
     SVMClassifier::Ptr svmc;
-    const int maxThreads = boost::thread::hardware_concurrency();   // For SVMTrainer
-    KernelFunc<cv::Mat>::Ptr kernel( new LinearKernel<cv::Mat>);
 
     int negLimit = posInstances_.size(); // Required number of negatives
     int iter = 0;
 
+    // Examples kept in the caches between rounds resume from their last multipliers
+    LinearSVMTrainer<cv::Mat> svmt( cost_, eps_);
+    svmt.enableErrorOutput(false);
+
     vector<cv::Mat> oldNegs;
     while ( iter++ < maxIterations_)
     {
@@ -273,9 +275,7 @@ SVMClassifier::Ptr SVMDataMiner::train()
 
         cerr << "\tTraining cache sizes (pos,neg) = " << posCache.size() << ", " << negCache.size() << endl;
 
-        SVMTrainer<cv::Mat> svmt( kernel, cost_, eps_, maxThreads);
-        svmt.enableErrorOutput(false);
-        svmc = svmt.train( posCache, negCache);
+        svmc = svmt.retrain( posCache, negCache);
 
         // shrink positive and negative caches to the misclassified examples or those that are close to the margin
         shrinkNegCache( svmc, negCache);
@@ -23,17 +23,28 @@ using RLearning::SVMNFoldCrossValidator;
 SVMNFoldCrossValidator::SVMNFoldCrossValidator( const SVMParams &svmp, int nf,
         const cv::Mat_<float>& xs, const cv::Mat_<int>& labels, int numEVs)
     : NFoldCrossValidator( nf, xs, labels, numEVs),
-    _kernel( svmp.makeKernel<cv::Mat_<float> >()), _cost(svmp.cost()), _eps(svmp.eps())
+    _kernel( svmp.makeKernel<cv::Mat_<float> >()), _cost(svmp.cost()), _eps(svmp.eps()), _maxIts(0), _maxSecs(0)
 {
 }   // end ctor
 
 
+void SVMNFoldCrossValidator::setTrainingLimits( uint maxIts, double maxSecs, const CancelToken::Ptr token)
+{
+    _maxIts = maxIts;
+    _maxSecs = maxSecs;
+    _cancel = token;
+}   // end setTrainingLimits
+
+
 
 //void SVMNFoldCrossValidator::train( const vector<cv::Mat> &tpset, const vector<cv::Mat> &tnset)
 void SVMNFoldCrossValidator::train( const cv::Mat_<float>& xs, const cv::Mat_<int>& labels)
 {
     SVMTrainer<cv::Mat_<float> > svmt( _kernel, _cost, _eps, boost::thread::hardware_concurrency());
     svmt.enableErrorOutput( false);
+    svmt.setMaxIterations( _maxIts);
+    svmt.setTimeLimit( _maxSecs);
+    svmt.setCancelToken( _cancel);
 
     vector<cv::Mat_<float> > tpset, tnset;
     CrossValidator::splitIntoPositiveAndNegativeClasses( xs, labels, tpset, tnset);
@@ -22,7 +22,7 @@ using RLearning::SVMParams;
 
 
 SVMParams::SVMParams( double cost, double eps)
-    : cost_(cost), eps_(eps), kernel_(LinearKernel<cv::Mat>::Type), gamma_(1), coef0_(0), degree_(1)
+    : cost_(cost), eps_(eps), kernel_(LinearKernel<cv::Mat>::Type), gamma_(1), coef0_(0), degree_(1), cacheSize_(0)
 {
 }   // end ctor
 
@@ -30,7 +30,7 @@ SVMParams::SVMParams( double cost, double eps)
 
 SVMParams::SVMParams( double cost, double eps, const string &ktype, double gam, double cf0, double deg)
     throw (InvalidKernelException)
-    : cost_(cost), eps_(eps), kernel_(ktype), gamma_(gam), coef0_(cf0), degree_(deg)
+    : cost_(cost), eps_(eps), kernel_(ktype), gamma_(gam), coef0_(cf0), degree_(deg), cacheSize_(0)
 {
     if ( !SVMParams::isKernelValid( ktype))
     {
@@ -0,0 +1,62 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "SVMTrainingObserver.h"
+using RLearning::SVMTrainingLogger;
+using RLearning::SVMTrainingProgress;
+#include <iomanip>
+
+
+SVMTrainingLogger::SVMTrainingLogger( std::ostream &os, Format fmt)
+    : os_(os), fmt_(fmt), wroteHeader_(false)
+{}   // end ctor
+
+
+void SVMTrainingLogger::progress( const SVMTrainingProgress &p)
+{
+    // Don't disturb the formatting of the stream (which may be shared e.g. with std::cerr)
+    const std::ios::fmtflags flags = os_.flags();
+    const std::streamsize prec = os_.precision();
+    os_.unsetf( std::ios::floatfield);
+    os_ << std::setprecision(8);
+
+    if ( fmt_ == CSV)
+    {
+        if ( !wroteHeader_)
+        {
+            os_ << "iteration,gap,active,examples,cache_hit_rate,kernel_evals,gathered,msecs,converged" << std::endl;
+            wroteHeader_ = true;
+        }   // end if
+        os_ << p.iteration << "," << p.gap << "," << p.activeSize << "," << p.numExamples << ","
+            << p.cacheHitRate << "," << p.kernelEvals << "," << p.gatheredValues << "," << p.msecs << "," << (p.converged ? 1 : 0) << std::endl;
+    }   // end if
+    else
+    {
+        os_ << "{\"iteration\":" << p.iteration
+            << ",\"gap\":" << p.gap
+            << ",\"active\":" << p.activeSize
+            << ",\"examples\":" << p.numExamples
+            << ",\"cache_hit_rate\":" << p.cacheHitRate
+            << ",\"kernel_evals\":" << p.kernelEvals
+            << ",\"gathered\":" << p.gatheredValues
+            << ",\"msecs\":" << p.msecs
+            << ",\"converged\":" << (p.converged ? "true" : "false") << "}" << std::endl;
+    }   // end else
+
+    os_.flags( flags);
+    os_.precision( prec);
+}   // end progress
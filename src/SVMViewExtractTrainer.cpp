@@ -171,10 +171,7 @@ SVMClassifier::Ptr SVMViewExtractTrainer::trainOnRange()
 
 SVMClassifier::Ptr SVMViewExtractTrainer::train()
 {
-    const int maxThreads = boost::thread::hardware_concurrency();
-    KernelFunc<cv::Mat>::Ptr kernel = svmp_.makeKernel<cv::Mat>();
-    SVMTrainer<cv::Mat> svmTrainer( kernel, svmp_.cost(), svmp_.eps(), maxThreads);
-    return svmTrainer.train( pexs_, nexs_);
+    return SVMTrainer<cv::Mat>::train( pexs_, nexs_, svmp_);
 }   // end train
 
 
@@ -0,0 +1,111 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "SparseMatrix.h"
+using RLearning::SparseMatrix;
+using RLearning::SparseRow;
+#include <cassert>
+#include <cstring>
+
+
+SparseMatrix::SparseMatrix( int cols) : cols_(cols), rowStart_( 1, 0)
+{
+}   // end ctor
+
+
+SparseMatrix::SparseMatrix( const cv::Mat_<float> &m) : cols_(m.cols), rowStart_( 1, 0)
+{
+    for ( int i = 0; i < m.rows; ++i)
+        addRow( m.row(i));
+}   // end ctor
+
+
+void SparseMatrix::addRow( const cv::Mat_<float> &x)
+{
+    assert( (int)x.total() == cols_);
+    int c = 0;
+    for ( int r = 0; r < x.rows; ++r)  // Row by row in case x isn't continuous
+    {
+        const float *xp = x.ptr<float>(r);
+        for ( int k = 0; k < x.cols; ++k, ++c)
+        {
+            if ( xp[k] == 0)
+                continue;
+            colIdx_.push_back( uint(c));
+            vals_.push_back( xp[k]);
+        }   // end for
+    }   // end for
+    rowStart_.push_back( uint(vals_.size()));
+}   // end addRow
+
+
+void SparseMatrix::addRow( const uint *idx, const float *val, uint nnz)
+{
+    for ( uint k = 0; k < nnz; ++k)
+    {
+        assert( (int)idx[k] < cols_ && (k == 0 || idx[k] > idx[k-1]));
+        colIdx_.push_back( idx[k]);
+        vals_.push_back( val[k]);
+    }   // end for
+    rowStart_.push_back( uint(vals_.size()));
+}   // end addRow
+
+
+cv::Mat_<float> SparseMatrix::toDense( int i) const
+{
+    cv::Mat_<float> x = cv::Mat_<float>::zeros( 1, cols_);
+    float *xp = x.ptr<float>(0);
+    const SparseRow r = row(i);
+    for ( uint k = 0; k < r.nnz; ++k)
+        xp[r.idx[k]] = r.val[k];
+    return x;
+}   // end toDense
+
+
+double RLearning::sparseDot( const SparseRow &x1, const SparseRow &x2)
+{
+    double s = 0;
+    uint a = 0, b = 0;
+    while ( a < x1.nnz && b < x2.nnz)
+    {
+        if ( x1.idx[a] < x2.idx[b])
+            a++;
+        else if ( x1.idx[a] > x2.idx[b])
+            b++;
+        else
+            s += double(x1.val[a++]) * x2.val[b++];
+    }   // end while
+    return s;
+}   // end sparseDot
+
+
+double RLearning::sparseDot( const SparseRow &x, const float *d)
+{
+    double s = 0;
+    for ( uint k = 0; k < x.nnz; ++k)
+        s += double(x.val[k]) * d[x.idx[k]];
+    return s;
+}   // end sparseDot
+
+
+double RLearning::sparseSqNorm( const SparseRow &x)
+{
+    double s = 0;
+    for ( uint k = 0; k < x.nnz; ++k)
+        s += double(x.val[k]) * x.val[k];
+    return s;
+}   // end sparseSqNorm
@@ -0,0 +1,913 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "VectorOps.h"
+#include <cstring>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RLEARNING_VECTOR_OPS_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * All versions of a reduction accumulate in double lanes of fixed width (16 for all
+ * versions so that results don't depend on which version a caller ends up in) which
+ * are summed pairwise at the end, then the remaining tail elements are added in order.
+ * Differences are taken in float but products of floats are exact in double so each
+ * lane sees the same sequence of roundings whether or not the add is fused.
+ */
+
+namespace {
+
+static const int LANES = 16;
+
+
+// Sum the LANES partial sums in a fixed order.
+inline double sumLanes( const double *acc)
+{
+    double s[LANES/2];
+    for ( int l = 0; l < LANES/2; ++l)
+        s[l] = acc[l] + acc[l+LANES/2];
+    for ( int w = LANES/4; w > 0; w /= 2)
+        for ( int l = 0; l < w; ++l)
+            s[l] = s[l] + s[l+w];
+    return s[0];
+}   // end sumLanes
+
+
+double dot_scalar( const float *x1, const float *x2, int n)
+{
+    double acc[LANES] = {0};
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+        for ( int l = 0; l < LANES; ++l)
+            acc[l] += double(x1[k+l]) * x2[k+l];
+    double s = sumLanes( acc);
+    for ( ; k < n; ++k)
+        s += double(x1[k]) * x2[k];
+    return s;
+}   // end dot_scalar
+
+
+double sqdist_scalar( const float *x1, const float *x2, int n)
+{
+    double acc[LANES] = {0};
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        for ( int l = 0; l < LANES; ++l)
+        {
+            const double d = x1[k+l] - x2[k+l];
+            acc[l] += d * d;
+        }   // end for
+    }   // end for
+    double s = sumLanes( acc);
+    for ( ; k < n; ++k)
+    {
+        const double d = x1[k] - x2[k];
+        s += d * d;
+    }   // end for
+    return s;
+}   // end sqdist_scalar
+
+
+void dot2_scalar( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    di = dot_scalar( xi, xk, n);
+    dj = dot_scalar( xj, xk, n);
+}   // end dot2_scalar
+
+
+void sqdist2_scalar( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    di = sqdist_scalar( xi, xk, n);
+    dj = sqdist_scalar( xj, xk, n);
+}   // end sqdist2_scalar
+
+
+template <typename R>
+void dotrows_scalar( const float *xi, const float *xj, const float *const *xks, uint nks, int n, R *di, R *dj)
+{
+    if ( xj == NULL)
+    {
+        for ( uint k = 0; k < nks; ++k)
+            di[k] = R( dot_scalar( xi, xks[k], n));
+        return;
+    }   // end if
+
+    double a, b;
+    for ( uint k = 0; k < nks; ++k)
+    {
+        dot2_scalar( xi, xj, xks[k], n, a, b);
+        di[k] = R(a);
+        dj[k] = R(b);
+    }   // end for
+}   // end dotrows_scalar
+
+
+template <typename R>
+void sqdistrows_scalar( const float *xi, const float *xj, const float *const *xks, uint nks, int n, R *di, R *dj)
+{
+    if ( xj == NULL)
+    {
+        for ( uint k = 0; k < nks; ++k)
+            di[k] = R( sqdist_scalar( xi, xks[k], n));
+        return;
+    }   // end if
+
+    double a, b;
+    for ( uint k = 0; k < nks; ++k)
+    {
+        sqdist2_scalar( xi, xj, xks[k], n, a, b);
+        di[k] = R(a);
+        dj[k] = R(b);
+    }   // end for
+}   // end sqdistrows_scalar
+
+
+// Over the row element type R so it also serves double precision kernel rows.
+template <typename R>
+void update_scalar( double *fns, const R *ri, const R *rj, double ai, double aj,
+                    const unsigned char *status, unsigned char hflag, unsigned char lflag,
+                    uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    for ( uint k = k0; k < k1; ++k)
+    {
+        const double f = fns[k] + (ai*ri[k] + aj*rj[k]);
+        fns[k] = f;
+        if ( (status[k] & hflag) && f < minf)
+        {
+            minf = f;
+            minIdx = k;
+        }   // end if
+        if ( (status[k] & lflag) && f > maxf)
+        {
+            maxf = f;
+            maxIdx = k;
+        }   // end if
+    }   // end for
+}   // end update_scalar
+
+
+// As update_scalar reading row entries at idx[k].
+template <typename R>
+void update_gather( double *fns, const R *ri, const R *rj, const uint *idx, double ai, double aj,
+                    const unsigned char *status, unsigned char hflag, unsigned char lflag,
+                    uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    for ( uint k = k0; k < k1; ++k)
+    {
+        const uint g = idx[k];
+        const double f = fns[k] + (ai*ri[g] + aj*rj[g]);
+        fns[k] = f;
+        if ( (status[k] & hflag) && f < minf)
+        {
+            minf = f;
+            minIdx = k;
+        }   // end if
+        if ( (status[k] & lflag) && f > maxf)
+        {
+            maxf = f;
+            maxIdx = k;
+        }   // end if
+    }   // end for
+}   // end update_gather
+
+
+double dotw_scalar( const double *w, const float *x, int n)
+{
+    double s = 0;
+    for ( int k = 0; k < n; ++k)
+        s += w[k] * x[k];
+    return s;
+}   // end dotw_scalar
+
+
+void axpy_scalar( double *w, double a, const float *x, int n)
+{
+    for ( int k = 0; k < n; ++k)
+        w[k] += a * x[k];
+}   // end axpy_scalar
+
+
+#ifdef RLEARNING_VECTOR_OPS_X86
+
+/****************************** AVX2 + FMA ******************************/
+
+__attribute__((target("avx2,fma")))
+inline __m256d lo_pd( __m256 v) { return _mm256_cvtps_pd( _mm256_castps256_ps128( v));}
+
+__attribute__((target("avx2,fma")))
+inline __m256d hi_pd( __m256 v) { return _mm256_cvtps_pd( _mm256_extractf128_ps( v, 1));}
+
+
+// Sum the four accumulators holding lanes [0,4), [4,8), [8,12) and [12,16).
+__attribute__((target("avx2,fma")))
+inline double sum_avx2( __m256d a0, __m256d a1, __m256d a2, __m256d a3)
+{
+    double acc[LANES];
+    _mm256_storeu_pd( acc, a0);
+    _mm256_storeu_pd( acc+4, a1);
+    _mm256_storeu_pd( acc+8, a2);
+    _mm256_storeu_pd( acc+12, a3);
+    return sumLanes( acc);
+}   // end sum_avx2
+
+
+__attribute__((target("avx2,fma")))
+double dot_avx2( const float *x1, const float *x2, int n)
+{
+    __m256d a0 = _mm256_setzero_pd();
+    __m256d a1 = _mm256_setzero_pd();
+    __m256d a2 = _mm256_setzero_pd();
+    __m256d a3 = _mm256_setzero_pd();
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m256 u0 = _mm256_loadu_ps( x1+k);
+        const __m256 u1 = _mm256_loadu_ps( x1+k+8);
+        const __m256 v0 = _mm256_loadu_ps( x2+k);
+        const __m256 v1 = _mm256_loadu_ps( x2+k+8);
+        a0 = _mm256_fmadd_pd( lo_pd(u0), lo_pd(v0), a0);
+        a1 = _mm256_fmadd_pd( hi_pd(u0), hi_pd(v0), a1);
+        a2 = _mm256_fmadd_pd( lo_pd(u1), lo_pd(v1), a2);
+        a3 = _mm256_fmadd_pd( hi_pd(u1), hi_pd(v1), a3);
+    }   // end for
+    double s = sum_avx2( a0, a1, a2, a3);
+    for ( ; k < n; ++k)
+        s += double(x1[k]) * x2[k];
+    return s;
+}   // end dot_avx2
+
+
+__attribute__((target("avx2,fma")))
+double sqdist_avx2( const float *x1, const float *x2, int n)
+{
+    __m256d a0 = _mm256_setzero_pd();
+    __m256d a1 = _mm256_setzero_pd();
+    __m256d a2 = _mm256_setzero_pd();
+    __m256d a3 = _mm256_setzero_pd();
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m256 d0 = _mm256_sub_ps( _mm256_loadu_ps( x1+k), _mm256_loadu_ps( x2+k));
+        const __m256 d1 = _mm256_sub_ps( _mm256_loadu_ps( x1+k+8), _mm256_loadu_ps( x2+k+8));
+        const __m256d e0 = lo_pd(d0), e1 = hi_pd(d0), e2 = lo_pd(d1), e3 = hi_pd(d1);
+        a0 = _mm256_fmadd_pd( e0, e0, a0);
+        a1 = _mm256_fmadd_pd( e1, e1, a1);
+        a2 = _mm256_fmadd_pd( e2, e2, a2);
+        a3 = _mm256_fmadd_pd( e3, e3, a3);
+    }   // end for
+    double s = sum_avx2( a0, a1, a2, a3);
+    for ( ; k < n; ++k)
+    {
+        const double d = x1[k] - x2[k];
+        s += d * d;
+    }   // end for
+    return s;
+}   // end sqdist_avx2
+
+
+__attribute__((target("avx2,fma")))
+void dot2_avx2( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    __m256d i0 = _mm256_setzero_pd(), i1 = i0, i2 = i0, i3 = i0;
+    __m256d j0 = i0, j1 = i0, j2 = i0, j3 = i0;
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m256 x0 = _mm256_loadu_ps( xk+k);
+        const __m256 x1 = _mm256_loadu_ps( xk+k+8);
+        const __m256d y0 = lo_pd(x0), y1 = hi_pd(x0), y2 = lo_pd(x1), y3 = hi_pd(x1);
+        const __m256 u0 = _mm256_loadu_ps( xi+k);
+        const __m256 u1 = _mm256_loadu_ps( xi+k+8);
+        i0 = _mm256_fmadd_pd( lo_pd(u0), y0, i0);
+        i1 = _mm256_fmadd_pd( hi_pd(u0), y1, i1);
+        i2 = _mm256_fmadd_pd( lo_pd(u1), y2, i2);
+        i3 = _mm256_fmadd_pd( hi_pd(u1), y3, i3);
+        const __m256 v0 = _mm256_loadu_ps( xj+k);
+        const __m256 v1 = _mm256_loadu_ps( xj+k+8);
+        j0 = _mm256_fmadd_pd( lo_pd(v0), y0, j0);
+        j1 = _mm256_fmadd_pd( hi_pd(v0), y1, j1);
+        j2 = _mm256_fmadd_pd( lo_pd(v1), y2, j2);
+        j3 = _mm256_fmadd_pd( hi_pd(v1), y3, j3);
+    }   // end for
+    double si = sum_avx2( i0, i1, i2, i3);
+    double sj = sum_avx2( j0, j1, j2, j3);
+    for ( ; k < n; ++k)
+    {
+        si += double(xi[k]) * xk[k];
+        sj += double(xj[k]) * xk[k];
+    }   // end for
+    di = si;
+    dj = sj;
+}   // end dot2_avx2
+
+
+__attribute__((target("avx2,fma")))
+void sqdist2_avx2( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    __m256d i0 = _mm256_setzero_pd(), i1 = i0, i2 = i0, i3 = i0;
+    __m256d j0 = i0, j1 = i0, j2 = i0, j3 = i0;
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m256 x0 = _mm256_loadu_ps( xk+k);
+        const __m256 x1 = _mm256_loadu_ps( xk+k+8);
+        const __m256 di0 = _mm256_sub_ps( _mm256_loadu_ps( xi+k), x0);
+        const __m256 di1 = _mm256_sub_ps( _mm256_loadu_ps( xi+k+8), x1);
+        const __m256 dj0 = _mm256_sub_ps( _mm256_loadu_ps( xj+k), x0);
+        const __m256 dj1 = _mm256_sub_ps( _mm256_loadu_ps( xj+k+8), x1);
+        const __m256d e0 = lo_pd(di0), e1 = hi_pd(di0), e2 = lo_pd(di1), e3 = hi_pd(di1);
+        const __m256d f0 = lo_pd(dj0), f1 = hi_pd(dj0), f2 = lo_pd(dj1), f3 = hi_pd(dj1);
+        i0 = _mm256_fmadd_pd( e0, e0, i0);
+        i1 = _mm256_fmadd_pd( e1, e1, i1);
+        i2 = _mm256_fmadd_pd( e2, e2, i2);
+        i3 = _mm256_fmadd_pd( e3, e3, i3);
+        j0 = _mm256_fmadd_pd( f0, f0, j0);
+        j1 = _mm256_fmadd_pd( f1, f1, j1);
+        j2 = _mm256_fmadd_pd( f2, f2, j2);
+        j3 = _mm256_fmadd_pd( f3, f3, j3);
+    }   // end for
+    double si = sum_avx2( i0, i1, i2, i3);
+    double sj = sum_avx2( j0, j1, j2, j3);
+    for ( ; k < n; ++k)
+    {
+        const double a = xi[k] - xk[k];
+        const double b = xj[k] - xk[k];
+        si += a * a;
+        sj += b * b;
+    }   // end for
+    di = si;
+    dj = sj;
+}   // end sqdist2_avx2
+
+
+template <typename R>
+__attribute__((target("avx2,fma")))
+void dotrows_avx2( const float *xi, const float *xj, const float *const *xks, uint nks, int n, R *di, R *dj)
+{
+    if ( xj == NULL)
+    {
+        for ( uint k = 0; k < nks; ++k)
+            di[k] = R( dot_avx2( xi, xks[k], n));
+        return;
+    }   // end if
+
+    double a, b;
+    for ( uint k = 0; k < nks; ++k)
+    {
+        dot2_avx2( xi, xj, xks[k], n, a, b);
+        di[k] = R(a);
+        dj[k] = R(b);
+    }   // end for
+}   // end dotrows_avx2
+
+
+template <typename R>
+__attribute__((target("avx2,fma")))
+void sqdistrows_avx2( const float *xi, const float *xj, const float *const *xks, uint nks, int n, R *di, R *dj)
+{
+    if ( xj == NULL)
+    {
+        for ( uint k = 0; k < nks; ++k)
+            di[k] = R( sqdist_avx2( xi, xks[k], n));
+        return;
+    }   // end if
+
+    double a, b;
+    for ( uint k = 0; k < nks; ++k)
+    {
+        sqdist2_avx2( xi, xj, xks[k], n, a, b);
+        di[k] = R(a);
+        dj[k] = R(b);
+    }   // end for
+}   // end sqdistrows_avx2
+
+
+// Lane-wise extrema are tracked with their indices (held exactly as doubles) and a
+// lane only takes a new value if it's strictly better so each lane keeps its first
+// occurrence. The lanes are then reduced taking the lowest index on equal values.
+__attribute__((target("avx2,fma")))
+void update_avx2( double *fns, const float *ri, const float *rj, double ai, double aj,
+                  const unsigned char *status, unsigned char hflag, unsigned char lflag,
+                  uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    const __m256d vai = _mm256_set1_pd( ai);
+    const __m256d vaj = _mm256_set1_pd( aj);
+    const __m256d pinf = _mm256_set1_pd( __builtin_inf());
+    const __m256d ninf = _mm256_set1_pd( -__builtin_inf());
+    const __m256i vh = _mm256_set1_epi64x( hflag);
+    const __m256i vl = _mm256_set1_epi64x( lflag);
+    const __m256d four = _mm256_set1_pd( 4);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256d vmin = pinf, vmax = ninf;
+    __m256d imin = _mm256_setzero_pd(), imax = _mm256_setzero_pd();
+    __m256d vidx = _mm256_setr_pd( k0, k0+1, k0+2, k0+3);
+
+    uint k = k0;
+    for ( ; k + 4 <= k1; k += 4)
+    {
+        const __m256d r1 = _mm256_cvtps_pd( _mm_loadu_ps( ri+k));
+        const __m256d r2 = _mm256_cvtps_pd( _mm_loadu_ps( rj+k));
+        const __m256d f = _mm256_add_pd( _mm256_loadu_pd( fns+k),
+                                         _mm256_fmadd_pd( vai, r1, _mm256_mul_pd( vaj, r2)));
+        _mm256_storeu_pd( fns+k, f);
+
+        int s4;
+        memcpy( &s4, status+k, 4);
+        const __m256i s = _mm256_cvtepu8_epi64( _mm_cvtsi32_si128( s4));
+        const __m256d inH = _mm256_castsi256_pd( _mm256_cmpgt_epi64( _mm256_and_si256( s, vh), zero));
+        const __m256d inL = _mm256_castsi256_pd( _mm256_cmpgt_epi64( _mm256_and_si256( s, vl), zero));
+
+        const __m256d lt = _mm256_and_pd( inH, _mm256_cmp_pd( f, vmin, _CMP_LT_OQ));
+        vmin = _mm256_blendv_pd( vmin, f, lt);
+        imin = _mm256_blendv_pd( imin, vidx, lt);
+        const __m256d gt = _mm256_and_pd( inL, _mm256_cmp_pd( f, vmax, _CMP_GT_OQ));
+        vmax = _mm256_blendv_pd( vmax, f, gt);
+        imax = _mm256_blendv_pd( imax, vidx, gt);
+        vidx = _mm256_add_pd( vidx, four);
+    }   // end for
+
+    double mv[4], mi[4], xv[4], xi[4];
+    _mm256_storeu_pd( mv, vmin);
+    _mm256_storeu_pd( mi, imin);
+    _mm256_storeu_pd( xv, vmax);
+    _mm256_storeu_pd( xi, imax);
+    for ( int l = 0; l < 4; ++l)
+    {
+        if ( mv[l] < minf || (mv[l] == minf && mv[l] != __builtin_inf() && uint(mi[l]) < minIdx))
+        {
+            minf = mv[l];
+            minIdx = uint(mi[l]);
+        }   // end if
+        if ( xv[l] > maxf || (xv[l] == maxf && xv[l] != -__builtin_inf() && uint(xi[l]) < maxIdx))
+        {
+            maxf = xv[l];
+            maxIdx = uint(xi[l]);
+        }   // end if
+    }   // end for
+
+    update_scalar( fns, ri, rj, ai, aj, status, hflag, lflag, k, k1, minf, minIdx, maxf, maxIdx);
+}   // end update_avx2
+
+
+__attribute__((target("avx2,fma")))
+double dotw_avx2( const double *w, const float *x, int n)
+{
+    __m256d a0 = _mm256_setzero_pd();
+    __m256d a1 = _mm256_setzero_pd();
+    int k = 0;
+    for ( ; k + 8 <= n; k += 8)
+    {
+        a0 = _mm256_fmadd_pd( _mm256_loadu_pd( w+k), _mm256_cvtps_pd( _mm_loadu_ps( x+k)), a0);
+        a1 = _mm256_fmadd_pd( _mm256_loadu_pd( w+k+4), _mm256_cvtps_pd( _mm_loadu_ps( x+k+4)), a1);
+    }   // end for
+    double acc[4];
+    _mm256_storeu_pd( acc, _mm256_add_pd( a0, a1));
+    double s = (acc[0] + acc[2]) + (acc[1] + acc[3]);
+    for ( ; k < n; ++k)
+        s += w[k] * x[k];
+    return s;
+}   // end dotw_avx2
+
+
+__attribute__((target("avx2,fma")))
+void axpy_avx2( double *w, double a, const float *x, int n)
+{
+    const __m256d va = _mm256_set1_pd( a);
+    int k = 0;
+    for ( ; k + 4 <= n; k += 4)
+        _mm256_storeu_pd( w+k, _mm256_fmadd_pd( va, _mm256_cvtps_pd( _mm_loadu_ps( x+k)), _mm256_loadu_pd( w+k)));
+    for ( ; k < n; ++k)
+        w[k] += a * x[k];
+}   // end axpy_avx2
+
+
+/******************************* AVX-512 ********************************/
+
+// Sum the two accumulators holding lanes [0,8) and [8,16).
+__attribute__((target("avx512f")))
+inline double sum_avx512( __m512d a0, __m512d a1)
+{
+    double acc[LANES];
+    _mm512_storeu_pd( acc, a0);
+    _mm512_storeu_pd( acc+8, a1);
+    return sumLanes( acc);
+}   // end sum_avx512
+
+
+__attribute__((target("avx512f")))
+double dot_avx512( const float *x1, const float *x2, int n)
+{
+    __m512d a0 = _mm512_setzero_pd();
+    __m512d a1 = _mm512_setzero_pd();
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        a0 = _mm512_fmadd_pd( _mm512_cvtps_pd( _mm256_loadu_ps( x1+k)), _mm512_cvtps_pd( _mm256_loadu_ps( x2+k)), a0);
+        a1 = _mm512_fmadd_pd( _mm512_cvtps_pd( _mm256_loadu_ps( x1+k+8)), _mm512_cvtps_pd( _mm256_loadu_ps( x2+k+8)), a1);
+    }   // end for
+    double s = sum_avx512( a0, a1);
+    for ( ; k < n; ++k)
+        s += double(x1[k]) * x2[k];
+    return s;
+}   // end dot_avx512
+
+
+__attribute__((target("avx512f")))
+double sqdist_avx512( const float *x1, const float *x2, int n)
+{
+    __m512d a0 = _mm512_setzero_pd();
+    __m512d a1 = _mm512_setzero_pd();
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m512d d0 = _mm512_cvtps_pd( _mm256_sub_ps( _mm256_loadu_ps( x1+k), _mm256_loadu_ps( x2+k)));
+        const __m512d d1 = _mm512_cvtps_pd( _mm256_sub_ps( _mm256_loadu_ps( x1+k+8), _mm256_loadu_ps( x2+k+8)));
+        a0 = _mm512_fmadd_pd( d0, d0, a0);
+        a1 = _mm512_fmadd_pd( d1, d1, a1);
+    }   // end for
+    double s = sum_avx512( a0, a1);
+    for ( ; k < n; ++k)
+    {
+        const double d = x1[k] - x2[k];
+        s += d * d;
+    }   // end for
+    return s;
+}   // end sqdist_avx512
+
+
+__attribute__((target("avx512f")))
+void dot2_avx512( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    __m512d i0 = _mm512_setzero_pd(), i1 = i0;
+    __m512d j0 = i0, j1 = i0;
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m512d x0 = _mm512_cvtps_pd( _mm256_loadu_ps( xk+k));
+        const __m512d x1 = _mm512_cvtps_pd( _mm256_loadu_ps( xk+k+8));
+        i0 = _mm512_fmadd_pd( _mm512_cvtps_pd( _mm256_loadu_ps( xi+k)), x0, i0);
+        i1 = _mm512_fmadd_pd( _mm512_cvtps_pd( _mm256_loadu_ps( xi+k+8)), x1, i1);
+        j0 = _mm512_fmadd_pd( _mm512_cvtps_pd( _mm256_loadu_ps( xj+k)), x0, j0);
+        j1 = _mm512_fmadd_pd( _mm512_cvtps_pd( _mm256_loadu_ps( xj+k+8)), x1, j1);
+    }   // end for
+    double si = sum_avx512( i0, i1);
+    double sj = sum_avx512( j0, j1);
+    for ( ; k < n; ++k)
+    {
+        si += double(xi[k]) * xk[k];
+        sj += double(xj[k]) * xk[k];
+    }   // end for
+    di = si;
+    dj = sj;
+}   // end dot2_avx512
+
+
+__attribute__((target("avx512f")))
+void sqdist2_avx512( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    __m512d i0 = _mm512_setzero_pd(), i1 = i0;
+    __m512d j0 = i0, j1 = i0;
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        const __m256 x0 = _mm256_loadu_ps( xk+k);
+        const __m256 x1 = _mm256_loadu_ps( xk+k+8);
+        const __m512d a0 = _mm512_cvtps_pd( _mm256_sub_ps( _mm256_loadu_ps( xi+k), x0));
+        const __m512d a1 = _mm512_cvtps_pd( _mm256_sub_ps( _mm256_loadu_ps( xi+k+8), x1));
+        const __m512d b0 = _mm512_cvtps_pd( _mm256_sub_ps( _mm256_loadu_ps( xj+k), x0));
+        const __m512d b1 = _mm512_cvtps_pd( _mm256_sub_ps( _mm256_loadu_ps( xj+k+8), x1));
+        i0 = _mm512_fmadd_pd( a0, a0, i0);
+        i1 = _mm512_fmadd_pd( a1, a1, i1);
+        j0 = _mm512_fmadd_pd( b0, b0, j0);
+        j1 = _mm512_fmadd_pd( b1, b1, j1);
+    }   // end for
+    double si = sum_avx512( i0, i1);
+    double sj = sum_avx512( j0, j1);
+    for ( ; k < n; ++k)
+    {
+        const double a = xi[k] - xk[k];
+        const double b = xj[k] - xk[k];
+        si += a * a;
+        sj += b * b;
+    }   // end for
+    di = si;
+    dj = sj;
+}   // end sqdist2_avx512
+
+
+template <typename R>
+__attribute__((target("avx512f")))
+void dotrows_avx512( const float *xi, const float *xj, const float *const *xks, uint nks, int n, R *di, R *dj)
+{
+    if ( xj == NULL)
+    {
+        for ( uint k = 0; k < nks; ++k)
+            di[k] = R( dot_avx512( xi, xks[k], n));
+        return;
+    }   // end if
+
+    double a, b;
+    for ( uint k = 0; k < nks; ++k)
+    {
+        dot2_avx512( xi, xj, xks[k], n, a, b);
+        di[k] = R(a);
+        dj[k] = R(b);
+    }   // end for
+}   // end dotrows_avx512
+
+
+template <typename R>
+__attribute__((target("avx512f")))
+void sqdistrows_avx512( const float *xi, const float *xj, const float *const *xks, uint nks, int n, R *di, R *dj)
+{
+    if ( xj == NULL)
+    {
+        for ( uint k = 0; k < nks; ++k)
+            di[k] = R( sqdist_avx512( xi, xks[k], n));
+        return;
+    }   // end if
+
+    double a, b;
+    for ( uint k = 0; k < nks; ++k)
+    {
+        sqdist2_avx512( xi, xj, xks[k], n, a, b);
+        di[k] = R(a);
+        dj[k] = R(b);
+    }   // end for
+}   // end sqdistrows_avx512
+
+
+__attribute__((target("avx512f")))
+void update_avx512( double *fns, const float *ri, const float *rj, double ai, double aj,
+                    const unsigned char *status, unsigned char hflag, unsigned char lflag,
+                    uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    const __m512d vai = _mm512_set1_pd( ai);
+    const __m512d vaj = _mm512_set1_pd( aj);
+    const __m512i vh = _mm512_set1_epi64( hflag);
+    const __m512i vl = _mm512_set1_epi64( lflag);
+    const __m512d eight = _mm512_set1_pd( 8);
+
+    __m512d vmin = _mm512_set1_pd( __builtin_inf());
+    __m512d vmax = _mm512_set1_pd( -__builtin_inf());
+    __m512d imin = _mm512_setzero_pd(), imax = _mm512_setzero_pd();
+    __m512d vidx = _mm512_setr_pd( k0, k0+1, k0+2, k0+3, k0+4, k0+5, k0+6, k0+7);
+
+    uint k = k0;
+    for ( ; k + 8 <= k1; k += 8)
+    {
+        const __m512d r1 = _mm512_cvtps_pd( _mm256_loadu_ps( ri+k));
+        const __m512d r2 = _mm512_cvtps_pd( _mm256_loadu_ps( rj+k));
+        const __m512d f = _mm512_add_pd( _mm512_loadu_pd( fns+k),
+                                         _mm512_fmadd_pd( vai, r1, _mm512_mul_pd( vaj, r2)));
+        _mm512_storeu_pd( fns+k, f);
+
+        const __m512i s = _mm512_cvtepu8_epi64( _mm_loadl_epi64( (const __m128i*)(status+k)));
+        const __mmask8 inH = _mm512_test_epi64_mask( s, vh);
+        const __mmask8 inL = _mm512_test_epi64_mask( s, vl);
+
+        const __mmask8 lt = _mm512_mask_cmp_pd_mask( inH, f, vmin, _CMP_LT_OQ);
+        vmin = _mm512_mask_mov_pd( vmin, lt, f);
+        imin = _mm512_mask_mov_pd( imin, lt, vidx);
+        const __mmask8 gt = _mm512_mask_cmp_pd_mask( inL, f, vmax, _CMP_GT_OQ);
+        vmax = _mm512_mask_mov_pd( vmax, gt, f);
+        imax = _mm512_mask_mov_pd( imax, gt, vidx);
+        vidx = _mm512_add_pd( vidx, eight);
+    }   // end for
+
+    double mv[8], mi[8], xv[8], xi[8];
+    _mm512_storeu_pd( mv, vmin);
+    _mm512_storeu_pd( mi, imin);
+    _mm512_storeu_pd( xv, vmax);
+    _mm512_storeu_pd( xi, imax);
+    for ( int l = 0; l < 8; ++l)
+    {
+        if ( mv[l] < minf || (mv[l] == minf && mv[l] != __builtin_inf() && uint(mi[l]) < minIdx))
+        {
+            minf = mv[l];
+            minIdx = uint(mi[l]);
+        }   // end if
+        if ( xv[l] > maxf || (xv[l] == maxf && xv[l] != -__builtin_inf() && uint(xi[l]) < maxIdx))
+        {
+            maxf = xv[l];
+            maxIdx = uint(xi[l]);
+        }   // end if
+    }   // end for
+
+    update_scalar( fns, ri, rj, ai, aj, status, hflag, lflag, k, k1, minf, minIdx, maxf, maxIdx);
+}   // end update_avx512
+
+__attribute__((target("avx512f")))
+double dotw_avx512( const double *w, const float *x, int n)
+{
+    __m512d a = _mm512_setzero_pd();
+    int k = 0;
+    for ( ; k + 8 <= n; k += 8)
+        a = _mm512_fmadd_pd( _mm512_loadu_pd( w+k), _mm512_cvtps_pd( _mm256_loadu_ps( x+k)), a);
+    double s = _mm512_reduce_add_pd( a);
+    for ( ; k < n; ++k)
+        s += w[k] * x[k];
+    return s;
+}   // end dotw_avx512
+
+
+__attribute__((target("avx512f")))
+void axpy_avx512( double *w, double a, const float *x, int n)
+{
+    const __m512d va = _mm512_set1_pd( a);
+    int k = 0;
+    for ( ; k + 8 <= n; k += 8)
+        _mm512_storeu_pd( w+k, _mm512_fmadd_pd( va, _mm512_cvtps_pd( _mm256_loadu_ps( x+k)), _mm512_loadu_pd( w+k)));
+    for ( ; k < n; ++k)
+        w[k] += a * x[k];
+}   // end axpy_avx512
+
+#endif  // RLEARNING_VECTOR_OPS_X86
+
+
+struct VectorOps
+{
+    double (*dot)( const float*, const float*, int);
+    double (*sqdist)( const float*, const float*, int);
+    void (*dot2)( const float*, const float*, const float*, int, double&, double&);
+    void (*sqdist2)( const float*, const float*, const float*, int, double&, double&);
+    void (*update)( double*, const float*, const float*, double, double, const unsigned char*,
+                    unsigned char, unsigned char, uint, uint, double&, uint&, double&, uint&);
+    void (*dotrows)( const float*, const float*, const float* const*, uint, int, float*, float*);
+    void (*sqdistrows)( const float*, const float*, const float* const*, uint, int, float*, float*);
+    void (*dotrowsd)( const float*, const float*, const float* const*, uint, int, double*, double*);
+    void (*sqdistrowsd)( const float*, const float*, const float* const*, uint, int, double*, double*);
+    double (*dotw)( const double*, const float*, int);
+    void (*axpy)( double*, double, const float*, int);
+    const char *name;
+
+    VectorOps()
+        : dot(dot_scalar), sqdist(sqdist_scalar), dot2(dot2_scalar), sqdist2(sqdist2_scalar),
+          update(update_scalar<float>),
+          dotrows(dotrows_scalar<float>), sqdistrows(sqdistrows_scalar<float>),
+          dotrowsd(dotrows_scalar<double>), sqdistrowsd(sqdistrows_scalar<double>), dotw(dotw_scalar), axpy(axpy_scalar), name("scalar")
+    {
+#ifdef RLEARNING_VECTOR_OPS_X86
+        __builtin_cpu_init();   // Needed since this may run before main
+        if ( __builtin_cpu_supports("avx512f"))
+        {
+            dot = dot_avx512;
+            sqdist = sqdist_avx512;
+            dot2 = dot2_avx512;
+            sqdist2 = sqdist2_avx512;
+            update = update_avx512;
+            dotrows = dotrows_avx512<float>;
+            sqdistrows = sqdistrows_avx512<float>;
+            dotrowsd = dotrows_avx512<double>;
+            sqdistrowsd = sqdistrows_avx512<double>;
+            dotw = dotw_avx512;
+            axpy = axpy_avx512;
+            name = "avx512";
+        }   // end if
+        else if ( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            dot = dot_avx2;
+            sqdist = sqdist_avx2;
+            dot2 = dot2_avx2;
+            sqdist2 = sqdist2_avx2;
+            update = update_avx2;
+            dotrows = dotrows_avx2<float>;
+            sqdistrows = sqdistrows_avx2<float>;
+            dotrowsd = dotrows_avx2<double>;
+            sqdistrowsd = sqdistrows_avx2<double>;
+            dotw = dotw_avx2;
+            axpy = axpy_avx2;
+            name = "avx2";
+        }   // end else if
+#endif
+    }   // end ctor
+};  // end struct
+
+
+// Function local so it's initialised before use by other static initialisers.
+const VectorOps& ops()
+{
+    static const VectorOps vops;
+    return vops;
+}   // end ops
+
+}   // end namespace
+
+
+double RLearning::dotProduct( const float *x1, const float *x2, int n)
+{
+    return ops().dot( x1, x2, n);
+}   // end dotProduct
+
+
+double RLearning::sqDistance( const float *x1, const float *x2, int n)
+{
+    return ops().sqdist( x1, x2, n);
+}   // end sqDistance
+
+
+void RLearning::dotProduct2( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    ops().dot2( xi, xj, xk, n, di, dj);
+}   // end dotProduct2
+
+
+void RLearning::sqDistance2( const float *xi, const float *xj, const float *xk, int n, double &di, double &dj)
+{
+    ops().sqdist2( xi, xj, xk, n, di, dj);
+}   // end sqDistance2
+
+
+void RLearning::updateAndSearch( double *fns, const float *ri, const float *rj, double ai, double aj,
+                                 const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                                 uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    ops().update( fns, ri, rj, ai, aj, status, highFlag, lowFlag, k0, k1, minf, minIdx, maxf, maxIdx);
+}   // end updateAndSearch
+
+
+void RLearning::updateAndSearch( double *fns, const double *ri, const double *rj, double ai, double aj,
+                                 const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                                 uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    update_scalar( fns, ri, rj, ai, aj, status, highFlag, lowFlag, k0, k1, minf, minIdx, maxf, maxIdx);
+}   // end updateAndSearch
+
+
+void RLearning::updateAndSearch( double *fns, const float *ri, const float *rj, const uint *idx, double ai, double aj,
+                                 const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                                 uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    update_gather( fns, ri, rj, idx, ai, aj, status, highFlag, lowFlag, k0, k1, minf, minIdx, maxf, maxIdx);
+}   // end updateAndSearch
+
+
+void RLearning::updateAndSearch( double *fns, const double *ri, const double *rj, const uint *idx, double ai, double aj,
+                                 const unsigned char *status, unsigned char highFlag, unsigned char lowFlag,
+                                 uint k0, uint k1, double &minf, uint &minIdx, double &maxf, uint &maxIdx)
+{
+    update_gather( fns, ri, rj, idx, ai, aj, status, highFlag, lowFlag, k0, k1, minf, minIdx, maxf, maxIdx);
+}   // end updateAndSearch
+
+
+double RLearning::dotProduct( const double *w, const float *x, int n)
+{
+    return ops().dotw( w, x, n);
+}   // end dotProduct
+
+
+void RLearning::addScaled( double *w, double a, const float *x, int n)
+{
+    ops().axpy( w, a, x, n);
+}   // end addScaled
+
+
+void RLearning::dotProductRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                                float *di, float *dj)
+{
+    ops().dotrows( xi, xj, xks, nks, n, di, dj);
+}   // end dotProductRows
+
+
+void RLearning::sqDistanceRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                                float *di, float *dj)
+{
+    ops().sqdistrows( xi, xj, xks, nks, n, di, dj);
+}   // end sqDistanceRows
+
+
+void RLearning::dotProductRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                                double *di, double *dj)
+{
+    ops().dotrowsd( xi, xj, xks, nks, n, di, dj);
+}   // end dotProductRows
+
+
+void RLearning::sqDistanceRows( const float *xi, const float *xj, const float *const *xks, uint nks, int n,
+                                double *di, double *dj)
+{
+    ops().sqdistrowsd( xi, xj, xks, nks, n, di, dj);
+}   // end sqDistanceRows
+
+
+std::string RLearning::vectorOpsInstructionSet()
+{
+    return ops().name;
+}   // end vectorOpsInstructionSet
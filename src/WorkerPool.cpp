@@ -0,0 +1,84 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+#include "WorkerPool.h"
+using RLearning::WorkerPool;
+#include <boost/bind.hpp>
+
+
+WorkerPool::WorkerPool( uint nthreads)
+    : _nthreads( nthreads), _start(NULL), _finish(NULL), _job(NULL), _stop(false)
+{
+    if ( _nthreads == 0)
+        _nthreads = boost::thread::hardware_concurrency();
+    if ( _nthreads == 0)
+        _nthreads = 1;
+
+    if ( _nthreads > 1)
+    {
+        _start = new boost::barrier( _nthreads);
+        _finish = new boost::barrier( _nthreads);
+        for ( uint t = 1; t < _nthreads; ++t)
+            _workers.create_thread( boost::bind( &WorkerPool::work, this, t));
+    }   // end if
+}   // end ctor
+
+
+
+WorkerPool::~WorkerPool()
+{
+    if ( _nthreads > 1)
+    {
+        _stop = true;
+        _start->wait(); // Release the workers to see the stop flag
+        _workers.join_all();
+        delete _start;
+        delete _finish;
+    }   // end if
+}   // end dtor
+
+
+
+void WorkerPool::run( const Job &job)
+{
+    if ( _nthreads == 1)
+    {
+        job(0);
+        return;
+    }   // end if
+
+    _job = &job;
+    _start->wait();     // Barrier orders the write of _job before the workers read it
+    job(0);
+    _finish->wait();    // All results written by the workers are visible after this
+    _job = NULL;
+}   // end run
+
+
+
+// private
+void WorkerPool::work( uint t)
+{
+    while ( true)
+    {
+        _start->wait();
+        if ( _stop)
+            break;
+        (*_job)(t);
+        _finish->wait();
+    }   // end while
+}   // end work
@@ -0,0 +1,128 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Benchmark comparing SVMTrainer with kernel values cached as float (the default)
+ * against caching them as double within the same cache memory budget. Reports the
+ * SMO iterations, training time, support vectors, threshold and the accuracy over
+ * the training examples and over held out examples from the same distribution.
+ * The double cache holds kernel values found in double so the two differ in both
+ * the precision of the kernel values and the number of rows the budget holds.
+ *
+ * Usage: cacheprec [examples per class] [dims] [kernel] [cost] [cache MB]
+ */
+
+#include <SVMTrainer.h>
+using RLearning::SVMTrainer;
+using RLearning::SVMClassifier;
+using RLearning::SVMParams;
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+#include <sys/time.h>
+
+typedef cv::Mat_<float> Example;
+
+
+// Standard normal deviate by the Box-Muller transform
+float randn()
+{
+    const double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    const double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return float( sqrt(-2*log(u1)) * cos(2*M_PI*u2));
+}   // end randn
+
+
+// Two overlapping Gaussian classes with means at +/- offset in every dimension
+void makeExamples( int n, int dims, vector<Example> &pos, vector<Example> &neg)
+{
+    const float offset = 0.35f;
+    for ( int i = 0; i < n; ++i)
+    {
+        Example p( 1, dims), q( 1, dims);
+        for ( int k = 0; k < dims; ++k)
+        {
+            p(0,k) = randn() + offset;
+            q(0,k) = randn() - offset;
+        }   // end for
+        pos.push_back(p);
+        neg.push_back(q);
+    }   // end for
+}   // end makeExamples
+
+
+double accuracy( const SVMClassifier &svmc, const vector<Example> &pos, const vector<Example> &neg)
+{
+    int correct = 0;
+    for ( size_t i = 0; i < pos.size(); ++i)
+        correct += svmc.predict( pos[i]) >= 0;
+    for ( size_t i = 0; i < neg.size(); ++i)
+        correct += svmc.predict( neg[i]) < 0;
+    return double(correct) / (pos.size() + neg.size());
+}   // end accuracy
+
+
+double msecsSince( const struct timeval &startTime)
+{
+    struct timeval endTime;
+    gettimeofday( &endTime, NULL);
+    return (endTime.tv_sec - startTime.tv_sec) * 1000.0 + (endTime.tv_usec - startTime.tv_usec) * 0.001;
+}   // end msecsSince
+
+
+template <typename V>
+void runTrainer( const char *name, const SVMParams &svmp,
+                 const vector<Example> &pos, const vector<Example> &neg,
+                 const vector<Example> &tpos, const vector<Example> &tneg)
+{
+    SVMTrainer<Example, V> svmt( svmp);
+    struct timeval startTime;
+    gettimeofday( &startTime, NULL);
+    const SVMClassifier::Ptr svmc = svmt.train( pos, neg);
+    const double msecs = msecsSince( startTime);
+
+    printf( "%-7s %10u %10.1f %7u %10.5f %9.4f %9.4f\n", name, svmt.getNumIterations(), msecs,
+            svmc->getNumSVs(), svmc->getThreshold(), accuracy( *svmc, pos, neg), accuracy( *svmc, tpos, tneg));
+}   // end runTrainer
+
+
+int main( int argc, char **argv)
+{
+    const int n = argc > 1 ? atoi( argv[1]) : 2000;
+    const int dims = argc > 2 ? atoi( argv[2]) : 64;
+    const string ktype = argc > 3 ? argv[3] : "rbf";
+    const double cost = argc > 4 ? atof( argv[4]) : 1;
+    const double cacheMB = argc > 5 ? atof( argv[5]) : 8;
+
+    srand(7);
+    vector<Example> pos, neg, tpos, tneg;
+    makeExamples( n, dims, pos, neg);
+    makeExamples( n, dims, tpos, tneg);
+
+    SVMParams svmp( cost, 1e-3, ktype, 1.0/dims, 1, 2);
+    svmp.cacheSize( cacheMB);
+
+    printf( "%d examples per class, %d dims, %s kernel, cost %g, %g MB cache\n", n, dims, ktype.c_str(), cost, cacheMB);
+    printf( "%-7s %10s %10s %7s %10s %9s %9s\n", "Cache", "Iterations", "msecs", "SVs", "Threshold", "TrainAcc", "TestAcc");
+    runTrainer<float>( "float", svmp, pos, neg, tpos, tneg);
+    runTrainer<double>( "double", svmp, pos, neg, tpos, tneg);
+    return EXIT_SUCCESS;
+}   // end main
@@ -0,0 +1,141 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Checks that evaluating the kernel functions (singly and in batches) and
+ * predicting with non-linear SVMClassifiers make no heap allocations.
+ * Exits with a non-zero status if any allocations are counted.
+ */
+
+#include <SVMClassifier.h>
+#include <SVMParams.h>
+#include <KernelFunc.h>
+#include <cstdlib>
+#include <new>
+#include <iostream>
+#include <string>
+using std::string;
+#include <vector>
+using std::vector;
+
+static size_t NUM_ALLOCS = 0;
+
+void* operator new( size_t sz)
+{
+    NUM_ALLOCS++;
+    void *p = malloc( sz > 0 ? sz : 1);
+    if ( p == NULL)
+        throw std::bad_alloc();
+    return p;
+}   // end operator new
+
+void* operator new[]( size_t sz)
+{
+    return operator new( sz);
+}   // end operator new[]
+
+void operator delete( void *p) throw() { free(p);}
+void operator delete[]( void *p) throw() { free(p);}
+
+
+typedef cv::Mat_<float> Example;
+typedef RLearning::KernelFunc<Example> Kernel;
+
+static const int DIMS = 100;
+static const int NUMX = 300;
+
+
+Example randomExample()
+{
+    Example x( 1, DIMS);
+    for ( int k = 0; k < DIMS; ++k)
+        x(0,k) = 2.0f * float(rand()) / RAND_MAX - 1;
+    return x;
+}   // end randomExample
+
+
+// Evaluate the kernel in all the ways used by the trainer and classifier and return the number of allocations made.
+size_t countKernelAllocs( const Kernel &kernel, const vector<Example> &xs, const vector<const float*> &xps,
+                          const vector<double> &sqs, vector<float> &ki, vector<float> &kj)
+{
+    const size_t n0 = NUM_ALLOCS;
+    double sum = 0;
+    for ( int i = 0; i < NUMX; ++i)
+    {
+        sum += kernel( xs[0], xs[i]);
+        sum += kernel( xps[0], xps[i], DIMS);
+    }   // end for
+    kernel.row( xps[0], &xps[0], NUMX, DIMS, &ki[0]);
+    kernel.rows( xps[0], xps[1], &xps[0], NUMX, DIMS, &ki[0], &kj[0]);
+    kernel.normRow( xps[0], sqs[0], &xps[0], &sqs[0], NUMX, DIMS, &ki[0]);
+    kernel.normRows( xps[0], sqs[0], xps[1], sqs[1], &xps[0], &sqs[0], NUMX, DIMS, &ki[0], &kj[0]);
+    const size_t nallocs = NUM_ALLOCS - n0;
+    if ( sum == 0)  // Keep the calls from being optimised away
+        std::cerr << "";
+    return nallocs;
+}   // end countKernelAllocs
+
+
+int main( int argc, char **argv)
+{
+    srand(1);
+    vector<Example> xs;
+    vector<const float*> xps;
+    vector<double> sqs;
+    for ( int i = 0; i < NUMX; ++i)
+    {
+        xs.push_back( randomExample());
+        xps.push_back( xs[i].ptr<float>(0));
+        sqs.push_back( xs[i].dot( xs[i]));
+    }   // end for
+    vector<float> ki( NUMX), kj( NUMX);
+    const Example z = randomExample();
+
+    const string ktypes[] = { "linear", "poly", "rbf", "sigmoid"};
+    int failed = 0;
+    for ( int t = 0; t < 4; ++t)
+    {
+        const RLearning::SVMParams svmp( 1, 1e-4, ktypes[t], 1.0/DIMS, 1, 2);
+        const Kernel::Ptr kernel = svmp.makeKernel<Example>();
+
+        countKernelAllocs( *kernel, xs, xps, sqs, ki, kj);  // Warm up (instruction set selection etc)
+        const size_t kallocs = countKernelAllocs( *kernel, xs, xps, sqs, ki, kj);
+
+        // Non-linear classifiers predict over the support vectors (here all the examples)
+        size_t pallocs = 0;
+        if ( !svmp.isLinear())
+        {
+            vector<double> *as = new vector<double>( NUMX);
+            vector<Example> *svs = new vector<Example>( xs);
+            for ( int i = 0; i < NUMX; ++i)
+                (*as)[i] = i % 2 ? 0.5 : -0.5;
+            const RLearning::SVMClassifier svmc( svmp, as, svs, 0.1);
+            svmc.predict( z);   // Warm up
+            const size_t n0 = NUM_ALLOCS;
+            for ( int i = 0; i < 10; ++i)
+                svmc.predict( z);
+            pallocs = NUM_ALLOCS - n0;
+        }   // end if
+
+        std::cout << ktypes[t] << ": " << kallocs << " kernel allocations, " << pallocs << " predict allocations" << std::endl;
+        if ( kallocs > 0 || pallocs > 0)
+            failed++;
+    }   // end for
+
+    std::cout << (failed ? "FAILED" : "PASSED") << std::endl;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}   // end main
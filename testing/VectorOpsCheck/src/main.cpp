@@ -0,0 +1,182 @@
+/************************************************************************
+ * Copyright (C) 2017 Richard Palmer
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ************************************************************************/
+
+/**
+ * Checks the vectorised inner products and squared distances of VectorOps (in whichever
+ * instruction set the CPU selects) against a scalar reference that accumulates in the
+ * same lane order, which they must match exactly, and against a long double sum, which
+ * they must be close to. The paired and batch versions (rounded to float or not) must
+ * match the single versions.
+ * Vector lengths cover the tail handling and long vectors with large offsets where a
+ * float accumulator would lose most of its precision. Returns non-zero on any failure.
+ *
+ * Usage: vecopscheck [max length] [trials per length]
+ */
+
+#include <VectorOps.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+using std::vector;
+
+
+// The scalar reference: 16 double lanes summed pairwise followed by the tail in order.
+double refReduce( const float *x1, const float *x2, int n, bool dist)
+{
+    static const int LANES = 16;
+    double acc[LANES] = {0};
+    int k = 0;
+    for ( ; k + LANES <= n; k += LANES)
+    {
+        for ( int l = 0; l < LANES; ++l)
+        {
+            const double d = dist ? double(x1[k+l] - x2[k+l]) : 0;
+            acc[l] += dist ? d*d : double(x1[k+l]) * x2[k+l];
+        }   // end for
+    }   // end for
+    for ( int w = LANES/2; w > 0; w /= 2)
+        for ( int l = 0; l < w; ++l)
+            acc[l] = acc[l] + acc[l+w];
+    double s = acc[0];
+    for ( ; k < n; ++k)
+    {
+        const double d = dist ? double(x1[k] - x2[k]) : 0;
+        s += dist ? d*d : double(x1[k]) * x2[k];
+    }   // end for
+    return s;
+}   // end refReduce
+
+
+// Sum in long double also returning the sum of the absolute terms to scale the tolerance.
+long double exactReduce( const float *x1, const float *x2, int n, bool dist, long double &mag)
+{
+    long double s = 0;
+    mag = 0;
+    for ( int k = 0; k < n; ++k)
+    {
+        const long double d = (long double)(x1[k] - x2[k]);
+        const long double t = dist ? d*d : (long double)(x1[k]) * x2[k];
+        s += t;
+        mag += fabsl(t);
+    }   // end for
+    return s;
+}   // end exactReduce
+
+
+float randf( float offset)
+{
+    return offset + 2.0f * float(rand()) / RAND_MAX - 1.0f;
+}   // end randf
+
+
+int failures = 0;
+
+void check( bool ok, const char *what, int n, double got, double want)
+{
+    if ( !ok)
+    {
+        ++failures;
+        fprintf( stderr, "FAIL %-14s n=%-7d got %.17g expected %.17g\n", what, n, got, want);
+    }   // end if
+}   // end check
+
+
+void checkLength( int n, float offset)
+{
+    vector<float> xi(n), xj(n), xk(n);
+    for ( int k = 0; k < n; ++k)
+    {
+        xi[k] = randf( offset);
+        xj[k] = randf( -offset);
+        xk[k] = randf( offset);
+    }   // end for
+    const float *pi = n ? &xi[0] : NULL;
+    const float *pj = n ? &xj[0] : NULL;
+    const float *pk = n ? &xk[0] : NULL;
+
+    for ( int dist = 0; dist < 2; ++dist)
+    {
+        const char *name = dist ? "sqDistance" : "dotProduct";
+        const double vi = dist ? RLearning::sqDistance( pi, pk, n) : RLearning::dotProduct( pi, pk, n);
+        const double vj = dist ? RLearning::sqDistance( pj, pk, n) : RLearning::dotProduct( pj, pk, n);
+
+        const double ri = refReduce( pi, pk, n, dist);
+        check( vi == ri, name, n, vi, ri);
+
+        long double mag;
+        const long double ei = exactReduce( pi, pk, n, dist, mag);
+        check( fabsl( vi - ei) <= 1e-12L * (mag + 1), name, n, vi, double(ei));
+
+        double di, dj;
+        if ( dist)
+            RLearning::sqDistance2( pi, pj, pk, n, di, dj);
+        else
+            RLearning::dotProduct2( pi, pj, pk, n, di, dj);
+        check( di == vi, dist ? "sqDistance2" : "dotProduct2", n, di, vi);
+        check( dj == vj, dist ? "sqDistance2" : "dotProduct2", n, dj, vj);
+
+        float fi, fj;
+        const float *xks[1] = {pk};
+        if ( dist)
+            RLearning::sqDistanceRows( pi, pj, xks, 1, n, &fi, &fj);
+        else
+            RLearning::dotProductRows( pi, pj, xks, 1, n, &fi, &fj);
+        check( fi == float(vi), dist ? "sqDistanceRows" : "dotProductRows", n, fi, float(vi));
+        check( fj == float(vj), dist ? "sqDistanceRows" : "dotProductRows", n, fj, float(vj));
+
+        double wi, wj;
+        if ( dist)
+            RLearning::sqDistanceRows( pi, pj, xks, 1, n, &wi, &wj);
+        else
+            RLearning::dotProductRows( pi, pj, xks, 1, n, &wi, &wj);
+        check( wi == vi, dist ? "sqDistanceRows" : "dotProductRows", n, wi, vi);
+        check( wj == vj, dist ? "sqDistanceRows" : "dotProductRows", n, wj, vj);
+    }   // end for
+}   // end checkLength
+
+
+int main( int argc, char **argv)
+{
+    int maxLen = 100;
+    int trials = 20;
+    if ( argc > 1)
+        maxLen = atoi( argv[1]);
+    if ( argc > 2)
+        trials = atoi( argv[2]);
+
+    srand(1);
+    printf( "Instruction set: %s\n", RLearning::vectorOpsInstructionSet().c_str());
+
+    for ( int n = 0; n <= maxLen; ++n)
+        for ( int t = 0; t < trials; ++t)
+            checkLength( n, 0.0f);
+
+    // Long vectors whose sums would be badly rounded with a float accumulator
+    const int longLens[] = {1000, 4099, 65536, 1000003};
+    for ( int i = 0; i < 4; ++i)
+    {
+        checkLength( longLens[i], 0.0f);
+        checkLength( longLens[i], 100.0f);
+    }   // end for
+
+    if ( failures)
+        printf( "%d checks failed\n", failures);
+    else
+        printf( "All checks passed\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}   // end main